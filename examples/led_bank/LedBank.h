@@ -0,0 +1,238 @@
+/*
+ * This file is part of the LazySerial library example code. It is licenced under the MIT Open Source licence.
+ * See the file LICENCE for details.
+ * Copyright (C) 2025 James Neko <arduino@neko.stream>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include <Arduino.h>
+
+
+namespace LedBank
+{
+  /**
+   * A bank of N LEDs blinking BlinkyLed-style 16-step patterns, each over its own interval.
+   * Rather than N objects each checking millis() and calling digitalWrite(), everything is kept in parallel
+   * arrays: loop() checks the one earliest deadline, steps whichever LEDs are due, and writes the changes out
+   * with one read-modify-write per port.
+   */
+  template <size_t N>
+  class LedBank
+  {
+  public:
+#ifdef portOutputRegister
+    // Whatever this core's registers are: volatile uint8_t * on AVR, volatile uint32_t * on ESP32 and ARM.
+    typedef decltype(portOutputRegister(0)) OutputRegister;
+    typedef decltype(digitalPinToBitMask(0)) BitMask;
+
+    BitMask        d_masks[N];
+    uint8_t        d_port_of[N];      // Index into d_ports.
+    OutputRegister d_ports[N];        // The distinct ports our pins are on...
+    uint8_t        d_port_count = 0;  // ...and how many of them there are.
+#endif
+    uint8_t  d_pins[N];
+    uint16_t d_patterns[N];
+    uint16_t d_intervals[N];  // Time for the whole 16 steps, in ms; 0 holds the LED at bit 0 of its pattern.
+    uint32_t d_next_ms[N];    // When each LED takes its next step.
+    uint8_t  d_steps[N];      // Which bit of the pattern each LED is showing.
+    uint8_t  d_levels[N];
+    uint32_t d_due_ms = 0;    // The earliest of d_next_ms, for LEDs that are blinking.
+    uint32_t d_usable = 0;    // One bit per LED whose pin exists; the rest are never touched.
+
+    LedBank(const uint8_t (&pins)[N], uint16_t interval_ms = 1000, uint16_t pattern = 0xFF00) {
+      for (size_t i = 0; i < N; ++i) {
+        d_pins[i] = pins[i];
+        d_patterns[i] = pattern;
+        d_intervals[i] = interval_ms;
+        d_steps[i] = 0;
+        d_levels[i] = LOW;
+        if ( ! isPin(pins[i])) {
+          continue;
+        }
+        d_usable |= 1UL << i;
+#ifdef portOutputRegister
+        d_masks[i] = digitalPinToBitMask(pins[i]);
+        d_port_of[i] = portIndex(portOutputRegister(digitalPinToPort(pins[i])));
+#endif
+      }
+    }
+
+
+    /**
+     * Call this during setup() to make the pins outputs and start everything blinking from step 0.
+     * Returns false if any of the pins doesn't exist on this board; those LEDs are left alone.
+     */
+    bool
+    begin() {
+      uint32_t now = millis();
+      for (size_t i = 0; i < N; ++i) {
+        if (d_usable & (1UL << i)) {
+          pinMode(d_pins[i], OUTPUT);
+          digitalWrite(d_pins[i], LOW);
+        }
+        restart(i, now);
+      }
+      return d_usable == ((N == 32) ? 0xFFFFFFFFUL : (1UL << N) - 1);
+    }
+
+
+    size_t
+    size() {
+      return N;
+    }
+
+
+    void
+    setPattern(uint8_t led, uint16_t pattern) {
+      d_patterns[led] = pattern;
+      restart(led, millis());
+    }
+
+
+    void
+    setInterval(uint8_t led, uint16_t interval_ms) {
+      d_intervals[led] = interval_ms;
+      restart(led, millis());
+    }
+
+
+    /**
+     * Call this from your own loop().
+     */
+    void
+    loop() {
+      uint32_t now = millis();
+      if (static_cast<int32_t>(now - d_due_ms) < 0) {
+        return;
+      }
+
+      // Nothing's due for a while if nothing's blinking.
+      uint32_t next_due = now + 0xFFFF;
+      uint32_t changed = 0;  // One bit per LED.
+      for (size_t i = 0; i < N; ++i) {
+        if (d_intervals[i] == 0) {
+          continue;
+        }
+        if (static_cast<int32_t>(now - d_next_ms[i]) >= 0) {
+          uint16_t step_ms = stepMs(i);
+          d_steps[i] = (d_steps[i] + 1) & 0x0F;
+          d_next_ms[i] += step_ms;
+          if (static_cast<int32_t>(now - d_next_ms[i]) >= 0) {
+            // We've fallen behind; don't try to catch up a step at a time.
+            d_next_ms[i] = now + step_ms;
+          }
+          uint8_t level = (d_patterns[i] >> d_steps[i]) & 0x01;
+          if (level != d_levels[i]) {
+            d_levels[i] = level;
+            changed |= 1UL << i;
+          }
+        }
+        if (static_cast<int32_t>(d_next_ms[i] - next_due) < 0) {
+          next_due = d_next_ms[i];
+        }
+      }
+      d_due_ms = next_due;
+      write(changed);
+    }
+
+
+  private:
+    static_assert(N <= 32, "LedBank keeps track of changes in a uint32_t");
+
+    uint16_t
+    stepMs(size_t led) {
+      uint16_t step_ms = d_intervals[led] / 16;
+      return step_ms ? step_ms : 1;
+    }
+
+
+    /**
+     * Start an LED's pattern over from step 0, and make sure loop() gets around to it.
+     */
+    void
+    restart(size_t led, uint32_t now) {
+      d_steps[led] = 0;
+      d_levels[led] = d_patterns[led] & 0x01;
+      d_next_ms[led] = now + stepMs(led);
+      if (d_intervals[led] && static_cast<int32_t>(d_next_ms[led] - d_due_ms) < 0) {
+        d_due_ms = d_next_ms[led];
+      }
+      write(1UL << led);
+    }
+
+
+    /**
+     * Whether 'pin' is one this board has. Asking an AVR for the port of any other pin reads past the end of
+     * its pin tables, and gives back NOT_A_PIN at best: port register 0.
+     */
+    static bool
+    isPin(uint8_t pin) {
+#ifdef NUM_DIGITAL_PINS
+      if (pin >= NUM_DIGITAL_PINS) {
+        return false;
+      }
+#endif
+#if defined(portOutputRegister) && defined(NOT_A_PIN)
+      if (digitalPinToPort(pin) == NOT_A_PIN) {
+        return false;
+      }
+#endif
+      return true;
+    }
+
+
+#ifdef portOutputRegister
+    uint8_t
+    portIndex(OutputRegister port) {
+      for (uint8_t i = 0; i < d_port_count; ++i) {
+        if (d_ports[i] == port) {
+          return i;
+        }
+      }
+      d_ports[d_port_count] = port;
+      return d_port_count++;
+    }
+#endif
+
+
+    /**
+     * Bring the pins of the LEDs flagged in 'changed' into line with d_levels.
+     */
+    void
+    write(uint32_t changed) {
+      changed &= d_usable;
+#ifdef portOutputRegister
+      BitMask set[N];
+      BitMask clear[N];
+      for (uint8_t p = 0; p < d_port_count; ++p) {
+        set[p] = 0;
+        clear[p] = 0;
+      }
+      for (size_t i = 0; changed; ++i, changed >>= 1) {
+        if (changed & 0x01) {
+          if (d_levels[i]) {
+            set[d_port_of[i]] |= d_masks[i];
+          } else {
+            clear[d_port_of[i]] |= d_masks[i];
+          }
+        }
+      }
+      for (uint8_t p = 0; p < d_port_count; ++p) {
+        if (set[p] | clear[p]) {
+          // Interrupt handlers may be writing to other pins on the same port.
+          noInterrupts();
+          *d_ports[p] = (*d_ports[p] | set[p]) & ~clear[p];
+          interrupts();
+        }
+      }
+#else
+      for (size_t i = 0; changed; ++i, changed >>= 1) {
+        if (changed & 0x01) {
+          digitalWrite(d_pins[i], d_levels[i]);
+        }
+      }
+#endif
+    }
+  };
+} // namespace
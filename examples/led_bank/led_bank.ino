@@ -0,0 +1,137 @@
+/*
+ * led_bank - drive a whole bank of status LEDs with blink patterns, setting many of them at once over serial.
+ *
+ * This file is part of the LazySerial library example code. It is licenced under the MIT Open Source licence.
+ * See the file LICENCE for details.
+ * Copyright (C) 2025 James Neko <arduino@neko.stream>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#include <LazySerial.h>
+#include "LedBank.h"
+
+#define BAUD_RATE 9600
+
+LazySerial::LazySerial<128> lazy(Serial);
+
+// One LED per pin, in the order the commands number them.
+const uint8_t ledPins[] = { 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13 };
+#define NUM_LEDS (sizeof(ledPins) / sizeof(ledPins[0]))
+LedBank::LedBank<NUM_LEDS> leds(ledPins);
+
+
+// ---------------- SERIAL COMMAND CALLBACKS ----------------
+
+#define ALL_WORDS "ALL"
+LAZY_KEYWORDS(allKeywords, ALL_WORDS);
+
+/**
+ * Parse "<ledNum>..." or "ALL" into a bitmask of LEDs.
+ */
+bool parse_leds(LazySerial::Context &context, uint32_t *selected) {
+  uint8_t all;
+  if (context.parse_keyword(allKeywords, &all)) {
+    *selected = (NUM_LEDS == 32) ? 0xFFFFFFFFUL : (1UL << NUM_LEDS) - 1;
+    context.parse_space();
+    return ! *(context.pos);
+  }
+  long nums[NUM_LEDS];
+  size_t count;
+  LAZY_RETURN_FALSE_UNLESS(context.parse_int_array(nums, NUM_LEDS, &count));
+  *selected = 0;
+  for (size_t i = 0; i < count; ++i) {
+    LAZY_RETURN_FALSE_IF(nums[i] < 0 || nums[i] >= static_cast<long>(NUM_LEDS));
+    *selected |= 1UL << nums[i];
+  }
+  // Anything left over is a mistake.
+  context.parse_space();
+  return ! *(context.pos);
+}
+
+void cmd_ohai(LazySerial::Context &context) {
+  LAZY_COMMAND("OHAI");
+  context.stream.println(F("OHAI led_bank " __TIMESTAMP__  ));
+}
+
+void cmd_leds(LazySerial::Context &context) {
+  LAZY_COMMAND("LEDS");
+  for (uint8_t i = 0; i < NUM_LEDS; ++i) {
+    context.response().str(F("LED ")).num(i).keyval(F("pin"), leds.d_pins[i])
+        .str(F(" pattern=0x")).hex(leds.d_patterns[i], 4).keyval(F("interval"), leds.d_intervals[i]).send();
+  }
+  context.response().str(F("OK LEDS ")).num(NUM_LEDS).send();
+}
+
+void cmd_pattern(LazySerial::Context &context) {
+  LAZY_COMMAND("PATTERN", "<pattern> (<ledNum>...|" ALL_WORDS ")");
+  uint16_t pattern;
+  uint32_t selected;
+  bool ok = context.parse_int(&pattern) && parse_leds(context, &selected);
+  LAZY_RETURN_USAGE_UNLESS(ok);
+
+  for (uint8_t i = 0; i < NUM_LEDS; ++i) {
+    if (selected & (1UL << i)) {
+      leds.setPattern(i, pattern);
+    }
+  }
+  context.response().str(F("OK PATTERN ")).hex(pattern, 4).send();
+}
+
+void cmd_interval(LazySerial::Context &context) {
+  LAZY_COMMAND("INTERVAL", "<ms> (<ledNum>...|" ALL_WORDS ")");
+  uint16_t interval_ms;
+  uint32_t selected;
+  bool ok = context.parse_int(&interval_ms) && parse_leds(context, &selected);
+  LAZY_RETURN_USAGE_UNLESS(ok);
+
+  for (uint8_t i = 0; i < NUM_LEDS; ++i) {
+    if (selected & (1UL << i)) {
+      leds.setInterval(i, interval_ms);
+    }
+  }
+  context.response().str(F("OK INTERVAL ")).num(interval_ms).send();
+}
+
+void cmd_patterns(LazySerial::Context &context) {
+  LAZY_COMMAND("PATTERNS", "<pattern>...");
+  // One pattern per LED, starting from LED 0; any LEDs left over are untouched.
+  uint16_t patterns[NUM_LEDS];
+  size_t count;
+  bool ok = context.parse_int_array(patterns, NUM_LEDS, &count);
+  LAZY_RETURN_USAGE_UNLESS(ok);
+  context.parse_space();
+  LAZY_RETURN_USAGE_IF(*(context.pos));
+
+  for (uint8_t i = 0; i < count; ++i) {
+    leds.setPattern(i, patterns[i]);
+  }
+  context.response().str(F("OK PATTERNS ")).num(count).send();
+}
+
+
+LazySerial::CallbackFunction commands[] = {
+  cmd_ohai,
+  cmd_leds,
+  cmd_pattern,
+  cmd_interval,
+  cmd_patterns,
+};
+
+
+// ---------------- MAIN ARDUINO FUNCTIONS ----------------
+
+void setup() {
+  Serial.begin(BAUD_RATE);
+  lazy.set_commands(commands);
+  if ( ! leds.begin()) {
+    Serial.println(F("ERR led_bank: some of ledPins aren't pins on this board"));
+  }
+}
+
+
+void loop() {
+  // One deadline check for the whole bank, and one write per port when something changes.
+  leds.loop();
+
+  lazy.loop();
+}
@@ -0,0 +1,353 @@
+/*
+ * This file is part of the LazySerial library example code. It is licenced under the MIT Open Source licence.
+ * See the file LICENCE for details.
+ * Copyright (C) 2025 James Neko <arduino@neko.stream>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include <Arduino.h>
+
+// How many samples a capture holds, one byte each.
+#ifndef CAPTURE_SAMPLES
+  #define CAPTURE_SAMPLES 256
+#endif
+
+// One bit per channel, so up to 8 pins per capture.
+#define CAPTURE_MAX_CHANNELS 8
+
+
+namespace Capture
+{
+  enum TriggerMode : uint8_t {
+    TRIGGER_RISE,
+    TRIGGER_FALL,
+    TRIGGER_HIGH,
+    TRIGGER_LOW,
+    TRIGGER_ABOVE,  // analogRead() of the trigger pin is at least the level.
+    TRIGGER_BELOW,  // analogRead() of the trigger pin is under the level.
+    TRIGGER_NOW,
+  };
+
+  enum State : uint8_t {
+    IDLE,
+    ARMED,     // loop() will start sampling.
+    DONE,      // Triggered, and the buffer has been filled.
+    TIMED_OUT, // Gave up waiting for the trigger; nothing useful in the buffer.
+  };
+
+
+  /**
+   * Burst capture of up to 8 digital pins, logic-analyzer style: sample at a fixed interval into a ring buffer
+   * until the trigger fires, keeping some samples from before it, then fill the rest of the buffer and stop.
+   * Sampling blocks loop() until done, or until the trigger timeout passes, so that the interval stays even;
+   * interrupts are left on, so expect a few microseconds of jitter while millis() and Serial do their thing.
+   */
+  class Capture
+  {
+  public:
+#ifdef portInputRegister
+    // Whatever this core's registers are: volatile uint8_t * on AVR, volatile uint32_t * on ESP32 and ARM.
+    typedef decltype(portInputRegister(0)) InputRegister;
+    typedef decltype(digitalPinToBitMask(0)) BitMask;
+
+    InputRegister d_registers[CAPTURE_MAX_CHANNELS];
+    BitMask       d_masks[CAPTURE_MAX_CHANNELS];
+    InputRegister d_trigger_register = nullptr;
+    BitMask       d_trigger_mask = 0;
+#endif
+    uint8_t  d_pins[CAPTURE_MAX_CHANNELS];
+    uint8_t  d_channels = 0;
+    uint32_t d_interval_us = 100;
+    uint16_t d_pre = 0;           // How many samples from before the trigger to keep.
+    uint8_t  d_trigger_pin = 0;
+    uint8_t  d_trigger_mode = TRIGGER_NOW;
+    int      d_trigger_level = 512;
+    uint32_t d_timeout_ms = 1000;
+    uint8_t  d_state = IDLE;
+    bool     d_late = false;      // Sampling couldn't keep up with the interval at some point.
+
+    uint8_t  d_samples[CAPTURE_SAMPLES];
+    uint16_t d_start = 0;         // Index of the oldest sample kept.
+    uint16_t d_count = 0;         // How many samples were kept.
+    uint16_t d_triggered = 0;     // How many of those came before the trigger.
+
+
+    /**
+     * Set which pins to sample; channel n of each sample is bit n. Returns false if there are too many, or if
+     * any of them isn't a pin we can read.
+     */
+    bool
+    setPins(const uint8_t *pins, uint8_t count) {
+      if (count == 0 || count > CAPTURE_MAX_CHANNELS) {
+        return false;
+      }
+      for (uint8_t i = 0; i < count; ++i) {
+        if ( ! isPin(pins[i])) {
+          return false;
+        }
+      }
+      for (uint8_t i = 0; i < count; ++i) {
+        d_pins[i] = pins[i];
+#ifdef portInputRegister
+        d_registers[i] = portInputRegister(digitalPinToPort(pins[i]));
+        d_masks[i] = digitalPinToBitMask(pins[i]);
+#endif
+      }
+      d_channels = count;
+      discard();
+      return true;
+    }
+
+
+    /**
+     * Like setPins(), these throw away any capture we have, which wasn't taken this way.
+     */
+    bool
+    setPre(uint16_t pre) {
+      if (pre >= CAPTURE_SAMPLES) {
+        return false;
+      }
+      d_pre = pre;
+      discard();
+      return true;
+    }
+
+
+    bool
+    setInterval(uint32_t interval_us) {
+      if (interval_us == 0 || interval_us > 1000000) {
+        return false;
+      }
+      d_interval_us = interval_us;
+      discard();
+      return true;
+    }
+
+
+    /**
+     * Returns false if the trigger is RISE, FALL, HIGH or LOW, and its pin isn't one we can read.
+     * ABOVE and BELOW hand their pin straight to analogRead(), and NOW doesn't have one.
+     */
+    bool
+    setTrigger(uint8_t mode, uint8_t pin = 0, int level = 0) {
+      bool digital = (mode <= TRIGGER_LOW);
+      if (digital && ! isPin(pin)) {
+        return false;
+      }
+      d_trigger_mode = mode;
+      d_trigger_pin = pin;
+      d_trigger_level = level;
+#ifdef portInputRegister
+      if (digital) {
+        d_trigger_register = portInputRegister(digitalPinToPort(pin));
+        d_trigger_mask = digitalPinToBitMask(pin);
+      }
+#endif
+      return true;
+    }
+
+
+    /**
+     * Start capturing on the next loop(). Returns false if there are no pins to capture.
+     */
+    bool
+    arm() {
+      if (d_channels == 0) {
+        return false;
+      }
+      d_count = 0;
+      d_late = false;
+      d_state = ARMED;
+      return true;
+    }
+
+
+    /**
+     * Returns true when an armed capture has finished, one way or the other; see d_state.
+     */
+    bool
+    loop() {
+      if (d_state != ARMED) {
+        return false;
+      }
+      run();
+      return true;
+    }
+
+
+    /**
+     * How many bytes dump() will write: the samples packed together at d_channels bits each.
+     */
+    size_t
+    dumpSize() {
+      return (static_cast<size_t>(d_count) * d_channels + 7) / 8;
+    }
+
+
+    /**
+     * Write the kept samples out, oldest first, packed d_channels bits per sample starting from the least
+     * significant bit of the first byte. The final byte is padded with zeros.
+     */
+    void
+    dump(Print &out) {
+      uint8_t chunk[32];
+      uint8_t used = 0;
+      uint16_t bits = 0;   // Sample bits waiting to be written out...
+      uint8_t  nbits = 0;  // ...and how many of them there are.
+      uint8_t  channel_mask = (1 << d_channels) - 1;
+      uint16_t index = d_start;
+      for (uint16_t i = 0; i < d_count; ++i) {
+        bits |= static_cast<uint16_t>(d_samples[index] & channel_mask) << nbits;
+        nbits += d_channels;
+        while (nbits >= 8) {
+          chunk[used++] = bits & 0xFF;
+          bits >>= 8;
+          nbits -= 8;
+          if (used == sizeof(chunk)) {
+            out.write(chunk, used);
+            used = 0;
+          }
+        }
+        if (++index == CAPTURE_SAMPLES) {
+          index = 0;
+        }
+      }
+      if (nbits) {
+        chunk[used++] = bits & 0xFF;
+      }
+      if (used) {
+        out.write(chunk, used);
+      }
+    }
+
+
+  private:
+    void
+    discard() {
+      d_count = 0;
+      d_late = false;
+      d_state = IDLE;
+    }
+
+
+    /**
+     * Whether 'pin' exists on this board, and has a port register to read it through. On AVR, looking up the
+     * port of anything else gives a null or garbage register.
+     */
+    static bool
+    isPin(uint8_t pin) {
+#ifdef NUM_DIGITAL_PINS
+      if (pin >= NUM_DIGITAL_PINS) {
+        return false;
+      }
+#endif
+#if defined(portInputRegister) && defined(NOT_A_PIN)
+      if (digitalPinToPort(pin) == NOT_A_PIN) {
+        return false;
+      }
+#endif
+      return true;
+    }
+
+
+    uint8_t
+    readChannels() {
+      uint8_t sample = 0;
+      for (uint8_t i = 0; i < d_channels; ++i) {
+#ifdef portInputRegister
+        if (*d_registers[i] & d_masks[i]) {
+#else
+        if (digitalRead(d_pins[i]) == HIGH) {
+#endif
+          sample |= (1 << i);
+        }
+      }
+      return sample;
+    }
+
+
+    bool
+    readTriggerPin() {
+#ifdef portInputRegister
+      return *d_trigger_register & d_trigger_mask;
+#else
+      return digitalRead(d_trigger_pin) == HIGH;
+#endif
+    }
+
+
+    bool
+    triggered(bool &last) {
+      switch (d_trigger_mode) {
+        case TRIGGER_RISE:
+        case TRIGGER_FALL: {
+          bool level = readTriggerPin();
+          bool edge = (level != last) && (level == (d_trigger_mode == TRIGGER_RISE));
+          last = level;
+          return edge;
+        }
+        case TRIGGER_HIGH:
+          return readTriggerPin();
+        case TRIGGER_LOW:
+          return ! readTriggerPin();
+        case TRIGGER_ABOVE:
+          return analogRead(d_trigger_pin) >= d_trigger_level;
+        case TRIGGER_BELOW:
+          return analogRead(d_trigger_pin) < d_trigger_level;
+        default:
+          return true;
+      }
+    }
+
+
+    /**
+     * The capture itself, from arming to a full buffer.
+     */
+    void
+    run() {
+      uint16_t head = 0;
+      uint16_t before = 0;  // Samples kept so far from before the trigger, up to d_pre.
+      uint16_t after = 0;   // Samples taken since, including the one the trigger fired on.
+      uint16_t wanted = CAPTURE_SAMPLES - d_pre;
+      bool last = (d_trigger_mode == TRIGGER_RISE || d_trigger_mode == TRIGGER_FALL) && readTriggerPin();
+      bool fired = false;
+      uint32_t start_ms = millis();
+      uint32_t next_us = micros();
+
+      while (after < wanted) {
+        // Wait for the next sample time.
+        while (static_cast<int32_t>(micros() - next_us) < 0) {
+        }
+        next_us += d_interval_us;
+
+        if ( ! fired) {
+          fired = triggered(last);
+          if ( ! fired && millis() - start_ms >= d_timeout_ms) {
+            d_count = 0;
+            d_state = TIMED_OUT;
+            return;
+          }
+        }
+        d_samples[head] = readChannels();
+        if (++head == CAPTURE_SAMPLES) {
+          head = 0;
+        }
+        if (fired) {
+          after++;
+        } else if (before < d_pre) {
+          before++;
+        }
+
+        if (static_cast<int32_t>(micros() - next_us) >= 0) {
+          d_late = true;
+        }
+      }
+
+      d_count = before + after;
+      d_triggered = before;
+      d_start = (head + CAPTURE_SAMPLES - d_count) % CAPTURE_SAMPLES;
+      d_state = DONE;
+    }
+  };
+} // namespace
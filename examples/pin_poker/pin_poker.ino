@@ -8,6 +8,7 @@
  * SPDX-License-Identifier: MIT
  */ 
 #include "BlinkyLed.h"
+#include "Capture.h"
 #include "Ticker.h"
 #include <LazySerial.h>
 
@@ -26,27 +27,70 @@ int beepMs = 1000;
 // ---------------- Digital / Analogue read  ----------------
 void ticker_read_val() {
   LAZY_RETURN_IF(monitorPin == -1);
-  Serial.print("MONITOR PIN ");
-  Serial.print(monitorPin);
-  Serial.print(" ");
+  LazySerial::Response response(Serial);
+  response.str(F("MONITOR PIN ")).num(monitorPin).ch(' ');
   if (monitorDigital) {
     val = digitalRead(monitorPin);
-    if (val == HIGH) {
-      Serial.println("HIGH");
-    } else {
-      Serial.println("LOW");
-    }
+    response.str(val == HIGH ? "HIGH" : "LOW");
   } else {
     val = analogRead(monitorPin);
-    Serial.print(" VALUE ");
-    Serial.println(val);
+    response.str(F(" VALUE ")).num(val);
   }
+  response.send();
 }
 Ticker::Ticker ticker(monitorFps, ticker_read_val);
 
 
+// ---------------- Change-driven pin watching ----------------
+LazySerial::WatchPool<8> watches(Serial);
+
+int32_t sample_digital(uint8_t pin) {
+  return digitalRead(pin);
+}
+
+int32_t sample_analog(uint8_t pin) {
+  return analogRead(pin);
+}
+
+
+// ---------------- Burst capture ----------------
+Capture::Capture capture;
+
+
 // ---------------- SERIAL COMMAND CALLBACKS ----------------
 
+// Subcommand keywords, in the order of the enums that index them. Each list is #defined once, so that the
+// usage text is built from the same words the table matches.
+#define PINMODE_WORDS "INPUT|INPUT_PULLUP|INPUT_PULLDOWN|OUTPUT"
+LAZY_KEYWORDS(pinModeKeywords, PINMODE_WORDS);
+const uint8_t pinModes[] = { INPUT, INPUT_PULLUP, INPUT_PULLDOWN, OUTPUT };
+
+#define MONITOR_WORDS "PIN|FPS|OFF|ANALOG|DIGITAL"
+LAZY_KEYWORDS(monitorKeywords, MONITOR_WORDS);
+enum MonitorKeyword { MONITOR_PIN, MONITOR_FPS, MONITOR_OFF, MONITOR_ANALOG, MONITOR_DIGITAL };
+
+#define BEEP_WORDS "PIN|TIME|STOP"
+LAZY_KEYWORDS(beepKeywords, BEEP_WORDS);
+enum BeepKeyword { BEEP_PIN, BEEP_TIME, BEEP_STOP };
+
+#define WATCH_WORDS "DIGITAL|ANALOG"
+LAZY_KEYWORDS(watchKeywords, WATCH_WORDS);
+enum WatchKeyword { WATCH_DIGITAL, WATCH_ANALOG };
+
+#define UNWATCH_WORDS "ALL"
+LAZY_KEYWORDS(unwatchKeywords, UNWATCH_WORDS);
+
+#define CAPTURE_WORDS "PINS|RATE|PRE|TRIGGER|TIMEOUT|ARM|DUMP"
+LAZY_KEYWORDS(captureKeywords, CAPTURE_WORDS);
+enum CaptureKeyword { CAPTURE_PINS, CAPTURE_RATE, CAPTURE_PRE, CAPTURE_TRIGGER, CAPTURE_TIMEOUT, CAPTURE_ARM, CAPTURE_DUMP };
+
+// In the order of Capture::TriggerMode and Capture::State. The trigger modes are split by what follows them.
+#define TRIGGER_PIN_WORDS "RISE|FALL|HIGH|LOW"
+#define TRIGGER_LEVEL_WORDS "ABOVE|BELOW"
+#define TRIGGER_NOW_WORDS "NOW"
+LAZY_KEYWORDS(triggerKeywords, TRIGGER_PIN_WORDS "|" TRIGGER_LEVEL_WORDS "|" TRIGGER_NOW_WORDS);
+LAZY_KEYWORDS(captureStates, "IDLE|ARMED|DONE|TIMEOUT");
+
 void cmd_ohai(LazySerial::Context &context) {
   LAZY_COMMAND("OHAI");
   context.stream.println(F("OHAI pin_poker " __TIMESTAMP__  ));
@@ -69,29 +113,20 @@ void cmd_blink(LazySerial::Context &context) {
 }
 
 void cmd_pinmode(LazySerial::Context &context) {
-  LAZY_COMMAND("PINMODE", "<pinNum> (INPUT|INPUT_PULLUP|INPUT_PULLDOWN|OUTPUT)");
+  LAZY_COMMAND("PINMODE", "<pinNum> (" PINMODE_WORDS ")");
   uint8_t pinNum = 0;
-  char *mode;
+  uint8_t mode;
   bool ok = context.parse_int_minmax<uint8_t>(&pinNum, 0, 255);
   LAZY_RETURN_USAGE_UNLESS(ok);
-  ok = context.parse_word(&mode);
+  ok = context.parse_keyword(pinModeKeywords, &mode);
   LAZY_RETURN_USAGE_UNLESS(ok);
 
-  if (strcasecmp(mode, "INPUT") == 0) {
-    pinMode(pinNum, INPUT);
-  } else if (strcasecmp(mode, "INPUT_PULLUP") == 0) {
-    pinMode(pinNum, INPUT_PULLUP);
-  } else if (strcasecmp(mode, "INPUT_PULLDOWN") == 0) {
-    pinMode(pinNum, INPUT_PULLDOWN);
-  } else if (strcasecmp(mode, "OUTPUT") == 0) {
-    pinMode(pinNum, OUTPUT);
-  } else {
-    LAZY_RETURN_USAGE_IF(true);
-  }
+  pinMode(pinNum, pinModes[mode]);
   context.stream.print("OK PINMODE ");
   context.stream.print(pinNum);
   context.stream.print(" ");
-  context.stream.println(mode);
+  pinModeKeywords.print(context.stream, mode);
+  context.stream.println();
 }
 
 void cmd_gpio(LazySerial::Context &context) {
@@ -116,79 +151,228 @@ void cmd_gpio(LazySerial::Context &context) {
 }
 
 void cmd_monitor(LazySerial::Context &context) {
-  LAZY_COMMAND("MONITOR", "(PIN <pinNum>|FPS <fps>|OFF|ANALOG|DIGITAL)+");
+  LAZY_COMMAND("MONITOR", "(" MONITOR_WORDS ")+, with PIN <pinNum> and FPS <fps>");
   LAZY_RETURN_USAGE_UNLESS(*(context.pos));
 
-  char *word;
-  while (context.parse_word(&word)) {
-    if (strcasecmp(word, "PIN") == 0) {
-      bool ok = context.parse_int(&monitorPin);
-      LAZY_RETURN_USAGE_UNLESS(ok);
-      
-    } else if (strcasecmp(word, "FPS") == 0) {
-      bool ok = context.parse_int(&monitorFps);
-      LAZY_RETURN_USAGE_UNLESS(ok);
-      ticker.tps(monitorFps);
-      
-    } else if (strcasecmp(word, "OFF") == 0) {
-      monitorPin = -1;
-
-    } else if (word[0] == 'a' || word[0] == 'A') {
-      monitorDigital = false;
-
-    } else if (word[0] == 'd' || word[0] == 'D') {
-      monitorDigital = true;
+  uint8_t keyword;
+  while (context.parse_keyword(monitorKeywords, &keyword)) {
+    switch (keyword) {
+      case MONITOR_PIN: {
+        bool ok = context.parse_int(&monitorPin);
+        LAZY_RETURN_USAGE_UNLESS(ok);
+        break;
+      }
+      case MONITOR_FPS: {
+        bool ok = context.parse_int(&monitorFps);
+        LAZY_RETURN_USAGE_UNLESS(ok);
+        ticker.tps(monitorFps);
+        break;
+      }
+      case MONITOR_OFF:
+        monitorPin = -1;
+        break;
+      case MONITOR_ANALOG:
+        monitorDigital = false;
+        break;
+      case MONITOR_DIGITAL:
+        monitorDigital = true;
+        break;
     }
   }
+  // Something we didn't recognise?
+  LAZY_RETURN_USAGE_IF(*(context.pos));
 
-  context.stream.print("OK MONITOR");
+  LazySerial::Response response = context.response();
+  response.str(F("OK MONITOR"));
   if (monitorPin == -1) {
-    context.stream.println(" OFF");
+    response.str(F(" OFF")).send();
     return;
   }
-  context.stream.print(" PIN ");
-  context.stream.print(monitorPin);
-  context.stream.print(" FPS ");
-  context.stream.print(monitorFps);
-  if (monitorDigital) {
-    context.stream.println(" DIGITAL");
-  } else {
-    context.stream.println(" ANALOG");
-  }
+  response.str(F(" PIN ")).num(monitorPin).str(F(" FPS ")).num(monitorFps);
+  response.str(monitorDigital ? " DIGITAL" : " ANALOG").send();
 }
 
 void cmd_beep(LazySerial::Context &context) {
-  LAZY_COMMAND("BEEP", "(PIN <pinNum>|TIME <ms>|STOP|<frequency>)+");
+  LAZY_COMMAND("BEEP", "(" BEEP_WORDS "|<frequency>)+, with PIN <pinNum> and TIME <ms>");
   LAZY_RETURN_USAGE_UNLESS(*(context.pos));
 
-  char *word;
-  while (context.parse_word(&word)) {
-    if (strcasecmp(word, "PIN") == 0) {
-      bool ok = context.parse_int(&beepPin);
+  uint8_t keyword;
+  for (context.parse_space(); *(context.pos); context.parse_space()) {
+    if ( ! context.parse_keyword(beepKeywords, &keyword)) {
+      // Not a keyword, so it should be a frequency.
+      int freq = 0;
+      bool ok = context.parse_int(&freq);
       LAZY_RETURN_USAGE_UNLESS(ok);
-      
-    } else if (strcasecmp(word, "TIME") == 0) {
-      bool ok = context.parse_int(&beepMs);
-      LAZY_RETURN_USAGE_UNLESS(ok);
-      
-    } else if (strcasecmp(word, "STOP") == 0) {
-      context.stream.print("OK BEEP STOP");
-      noTone(beepPin);
-
-    } else {
-      int freq = atoi(word);
-      context.stream.print("OK BEEP ");
-      context.stream.println(freq);
+      context.response().str(F("OK BEEP ")).num(freq).send();
       tone(beepPin, freq, beepMs);
       return;
     }
+
+    switch (keyword) {
+      case BEEP_PIN: {
+        bool ok = context.parse_int(&beepPin);
+        LAZY_RETURN_USAGE_UNLESS(ok);
+        break;
+      }
+      case BEEP_TIME: {
+        bool ok = context.parse_int(&beepMs);
+        LAZY_RETURN_USAGE_UNLESS(ok);
+        break;
+      }
+      case BEEP_STOP:
+        context.stream.print("OK BEEP STOP");
+        noTone(beepPin);
+        break;
+    }
+  }
+
+  context.response().str(F("OK BEEP PIN ")).num(beepPin).str(F(" TIME ")).num(beepMs).send();
+}
+
+void cmd_watch(LazySerial::Context &context) {
+  LAZY_COMMAND("WATCH", "[" WATCH_WORDS "] <pinNum> [deadband] [minMs] [heartbeatMs] [threshold]");
+  uint8_t mode = WATCH_DIGITAL;
+  context.parse_keyword(watchKeywords, &mode);
+  uint8_t pinNum = 0;
+  bool ok = context.parse_int_minmax<uint8_t>(&pinNum, 0, 255);
+  LAZY_RETURN_USAGE_UNLESS(ok);
+  // The rest are optional, but anything left over after them is a mistake.
+  int32_t options[4] = { 0, 0, 0, LazySerial::NO_THRESHOLD };
+  size_t count;
+  context.parse_int_array(options, 4, &count);
+  context.parse_space();
+  LAZY_RETURN_USAGE_IF(*(context.pos));
+  // deadband can't be negative, and the two times have to fit WatchPool's uint16_t.
+  LAZY_RETURN_USAGE_IF(options[0] < 0);
+  LAZY_RETURN_USAGE_IF(options[1] < 0 || options[1] > 65535);
+  LAZY_RETURN_USAGE_IF(options[2] < 0 || options[2] > 65535);
+
+  ok = watches.add(pinNum, mode == WATCH_ANALOG ? sample_analog : sample_digital, options[0], options[1], options[2], options[3]);
+  if ( ! ok) {
+    context.stream.println(F("ERR WATCH too many watches"));
+    return;
+  }
+  context.response().str(F("OK WATCH ")).num(pinNum).str(mode == WATCH_ANALOG ? " ANALOG" : " DIGITAL")
+      .keyval(F("deadband"), options[0]).keyval(F("minMs"), options[1]).keyval(F("heartbeatMs"), options[2]).send();
+}
+
+void cmd_unwatch(LazySerial::Context &context) {
+  LAZY_COMMAND("UNWATCH", "(<pinNum>|" UNWATCH_WORDS ")");
+  uint8_t all;
+  if (context.parse_keyword(unwatchKeywords, &all)) {
+    watches.clear();
+    context.stream.println(F("OK UNWATCH ALL"));
+    return;
+  }
+  uint8_t pinNum = 0;
+  bool ok = context.parse_int_minmax<uint8_t>(&pinNum, 0, 255);
+  LAZY_RETURN_USAGE_UNLESS(ok);
+  ok = watches.remove(pinNum);
+  LAZY_RETURN_USAGE_UNLESS(ok);
+  context.response().str(F("OK UNWATCH ")).num(pinNum).send();
+}
+
+void cmd_capture(LazySerial::Context &context) {
+  LAZY_COMMAND("CAPTURE", "(" CAPTURE_WORDS ")*, with PINS <pinNum>..., RATE <us>, PRE <samples>, TIMEOUT <ms>, "
+                          "and TRIGGER ((" TRIGGER_PIN_WORDS ") <pinNum>|(" TRIGGER_LEVEL_WORDS ") <pinNum> <level>|"
+                          TRIGGER_NOW_WORDS ")");
+
+  uint8_t keyword;
+  bool arm = false;
+  bool dump = false;
+  while (context.parse_keyword(captureKeywords, &keyword)) {
+    switch (keyword) {
+      case CAPTURE_PINS: {
+        // Parsed wide, so that "PINS 300" is an error rather than pin 44.
+        long pinNums[CAPTURE_MAX_CHANNELS];
+        uint8_t pins[CAPTURE_MAX_CHANNELS];
+        size_t count;
+        bool ok = context.parse_int_array(pinNums, CAPTURE_MAX_CHANNELS, &count);
+        LAZY_RETURN_USAGE_UNLESS(ok);
+        for (size_t i = 0; i < count; ++i) {
+          LAZY_RETURN_USAGE_IF(pinNums[i] < 0 || pinNums[i] > 255);
+          pins[i] = pinNums[i];
+        }
+        ok = capture.setPins(pins, count);
+        LAZY_RETURN_USAGE_UNLESS(ok);
+        break;
+      }
+      case CAPTURE_RATE: {
+        uint32_t interval_us;
+        bool ok = context.parse_int_minmax<uint32_t>(&interval_us, 1, 1000000) && capture.setInterval(interval_us);
+        LAZY_RETURN_USAGE_UNLESS(ok);
+        break;
+      }
+      case CAPTURE_PRE: {
+        uint16_t pre;
+        bool ok = context.parse_int(&pre) && capture.setPre(pre);
+        LAZY_RETURN_USAGE_UNLESS(ok);
+        break;
+      }
+      case CAPTURE_TRIGGER: {
+        uint8_t mode;
+        uint8_t pinNum = 0;
+        int level = 0;
+        bool ok = context.parse_keyword(triggerKeywords, &mode);
+        LAZY_RETURN_USAGE_UNLESS(ok);
+        if (mode != Capture::TRIGGER_NOW) {
+          ok = context.parse_int_minmax<uint8_t>(&pinNum, 0, 255);
+          LAZY_RETURN_USAGE_UNLESS(ok);
+        }
+        if (mode == Capture::TRIGGER_ABOVE || mode == Capture::TRIGGER_BELOW) {
+          ok = context.parse_int(&level);
+          LAZY_RETURN_USAGE_UNLESS(ok);
+        }
+        ok = capture.setTrigger(mode, pinNum, level);
+        LAZY_RETURN_USAGE_UNLESS(ok);
+        break;
+      }
+      case CAPTURE_TIMEOUT: {
+        bool ok = context.parse_int_minmax<uint32_t>(&capture.d_timeout_ms, 1, 60000);
+        LAZY_RETURN_USAGE_UNLESS(ok);
+        break;
+      }
+      case CAPTURE_ARM:
+        arm = true;
+        break;
+      case CAPTURE_DUMP:
+        dump = true;
+        break;
+    }
+  }
+  // Something we didn't recognise?
+  LAZY_RETURN_USAGE_IF(*(context.pos));
+
+  if (dump) {
+    if (capture.d_state != Capture::DONE) {
+      context.stream.println(F("ERR CAPTURE nothing captured"));
+      return;
+    }
+    // Header, then exactly 'bytes' of packed samples.
+    context.response().str(F("OK CAPTURE DUMP ")).num(capture.d_count).ch(' ').num(capture.d_channels)
+        .ch(' ').num(capture.d_triggered).ch(' ').num(capture.d_interval_us).ch(' ').num(capture.dumpSize()).send();
+    capture.dump(context.stream);
+    return;
+  }
+  if (arm && ! capture.arm()) {
+    context.stream.println(F("ERR CAPTURE no pins"));
+    return;
   }
 
-  context.stream.print("OK BEEP");
-  context.stream.print(" PIN ");
-  context.stream.print(beepPin);
-  context.stream.print(" TIME ");
-  context.stream.println(beepMs);
+  context.stream.print(F("OK CAPTURE "));
+  captureStates.print(context.stream, capture.d_state);
+  context.stream.print(F(" TRIGGER "));
+  triggerKeywords.print(context.stream, capture.d_trigger_mode);
+  LazySerial::Response response = context.response();
+  if (capture.d_trigger_mode != Capture::TRIGGER_NOW) {
+    response.ch(' ').num(capture.d_trigger_pin);
+  }
+  response.str(F(" PINS"));
+  for (uint8_t i = 0; i < capture.d_channels; ++i) {
+    response.ch(' ').num(capture.d_pins[i]);
+  }
+  response.keyval(F("rateUs"), capture.d_interval_us).keyval(F("pre"), capture.d_pre).keyval(F("count"), capture.d_count);
+  response.keyval(F("late"), capture.d_late ? 1 : 0).send();
 }
 
 LazySerial::CallbackFunction commands[] = {
@@ -199,12 +383,22 @@ LazySerial::CallbackFunction commands[] = {
   cmd_gpio,
   cmd_monitor,
   cmd_beep,
+  cmd_watch,
+  cmd_unwatch,
+  cmd_capture,
 };
 
 
+// Lets the host move us to a faster link with the built-in BAUD command.
+void change_baud(uint32_t baud) {
+  Serial.begin(baud);
+}
+
+
 void setup() {
   Serial.begin(BAUD_RATE);
   lazy.set_commands(commands);
+  lazy.set_baud_callback(change_baud, BAUD_RATE);
   Serial.println("OK STARTING");
 }
 
@@ -212,5 +406,13 @@ void loop() {
   lazy.loop();
   blinky.loop();
   ticker.loop();
+  watches.loop();
+  if (capture.loop()) {
+    if (capture.d_state == Capture::DONE) {
+      LazySerial::Response(Serial).str(F("EVENT CAPTURE DONE ")).num(capture.d_count).send();
+    } else {
+      Serial.println(F("EVENT CAPTURE TIMEOUT"));
+    }
+  }
 }
 
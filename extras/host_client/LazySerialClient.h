@@ -0,0 +1,469 @@
+/*
+ * This file is part of the LazySerial library.
+ * Copyright (C) 2025 Lazy Cat Software <arduino@neko.stream>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+// Host-side (Linux / POSIX) client for talking to a LazySerial device. Not part of the Arduino library proper.
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <strings.h>
+#include <vector>
+
+
+namespace LazySerial
+{
+  namespace Host
+  {
+    /**
+     * How replies are paired up with the commands that were sent.
+     */
+    enum class Match {
+      ORDER,  // Each OK / ERR line answers the oldest command still waiting.
+      NAME,   // An "OK NAME ..." or "ERR Usage: NAME ..." line answers the oldest waiting command called NAME.
+    };
+
+
+    /**
+     * What came back for one command.
+     */
+    struct Reply {
+      uint32_t tag = 0;                 // As returned by Client::send().
+      std::string command;              // What was sent.
+      bool ok = false;                  // "OK ..." rather than "ERR ..."
+      bool usage = false;               // "ERR Usage: ...", i.e. the device didn't like the args.
+      std::string line;                 // The OK / ERR line itself.
+      std::vector<std::string> output;  // Any other lines printed before it.
+      uint32_t latency_us = 0;          // From sending the command to receiving the OK / ERR.
+    };
+
+
+    /**
+     * Round-trip latency samples, for percentiles.
+     */
+    class Latency {
+    public:
+      void
+      add(uint32_t us) {
+        d_samples.push_back(us);
+      }
+
+      size_t
+      count() const {
+        return d_samples.size();
+      }
+
+      void
+      clear() {
+        d_samples.clear();
+      }
+
+      /**
+       * The p'th percentile (0-100), in microseconds; 0 if there are no samples.
+       */
+      uint32_t
+      percentile(double p) const {
+        if (d_samples.empty()) {
+          return 0;
+        }
+        std::vector<uint32_t> sorted(d_samples);
+        size_t rank = std::min(sorted.size() - 1, static_cast<size_t>(p / 100.0 * sorted.size()));
+        std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+        return sorted[rank];
+      }
+
+      double
+      mean() const {
+        if (d_samples.empty()) {
+          return 0;
+        }
+        double total = 0;
+        for (uint32_t us : d_samples) {
+          total += us;
+        }
+        return total / d_samples.size();
+      }
+
+    private:
+      std::vector<uint32_t> d_samples;
+    };
+
+
+    /**
+     * Drives a LazySerial device over a tty, pty, or any other file descriptor such as one end of a socketpair.
+     * Commands can be pipelined: send() several, then poll() for their replies as they come back.
+     * Lines that aren't part of any reply (e.g. MONITOR output with nothing waiting) are kept as unsolicited.
+     * Commands whose reply doesn't end with an OK / ERR line can't be told apart from those, so will time out.
+     */
+    class Client {
+    public:
+      typedef std::chrono::steady_clock Clock;
+
+      Client() :
+        d_fd(-1),
+        d_baud(0),
+        d_match(Match::ORDER),
+        d_next_tag(1) {  }
+
+      ~Client() {
+        close();
+      }
+
+      /**
+       * Open a tty or pty, in raw mode at the given baud rate. Returns if it went ok.
+       */
+      bool
+      open(
+          const char *path,
+          uint32_t baud) {
+        close();
+        d_fd = ::open(path, O_RDWR | O_NOCTTY);
+        if (d_fd < 0) {
+          return false;
+        }
+        struct termios tio;
+        if (tcgetattr(d_fd, &tio) != 0) {
+          close();
+          return false;
+        }
+        cfmakeraw(&tio);
+        tio.c_cflag |= CLOCAL | CREAD;
+        if (tcsetattr(d_fd, TCSANOW, &tio) != 0 || ! set_baud(baud)) {
+          close();
+          return false;
+        }
+        return true;
+      }
+
+      /**
+       * Use a descriptor that's already open, e.g. a socketpair. The Client will close it.
+       */
+      void
+      adopt(
+          int fd) {
+        close();
+        d_fd = fd;
+      }
+
+      void
+      close() {
+        if (d_fd >= 0) {
+          ::close(d_fd);
+        }
+        d_fd = -1;
+        d_in.clear();
+        d_waiting.clear();
+      }
+
+      bool
+      is_open() const {
+        return d_fd >= 0;
+      }
+
+      void
+      set_match(
+          Match match) {
+        d_match = match;
+      }
+
+      /**
+       * Change the local baud rate only; see negotiate_baud() to do it properly. Returns if it went ok.
+       * Always ok for descriptors that aren't ttys.
+       */
+      bool
+      set_baud(
+          uint32_t baud) {
+        struct termios tio;
+        if ( ! isatty(d_fd) || tcgetattr(d_fd, &tio) != 0) {
+          d_baud = baud;
+          return true;
+        }
+        speed_t speed = to_speed(baud);
+        if (speed == B0 || cfsetispeed(&tio, speed) != 0 || cfsetospeed(&tio, speed) != 0) {
+          return false;
+        }
+        tcdrain(d_fd);
+        if (tcsetattr(d_fd, TCSANOW, &tio) != 0) {
+          return false;
+        }
+        tcflush(d_fd, TCIFLUSH);  // Anything already received at the old rate is garbage now.
+        d_in.clear();
+        d_baud = baud;
+        return true;
+      }
+
+      /**
+       * Send a command, without waiting for its reply. Returns a tag to spot the reply by, or 0 on error.
+       */
+      uint32_t
+      send(
+          const std::string &command) {
+        std::string line = command + "\n";
+        const char *data = line.data();
+        size_t left = line.size();
+        while (left) {
+          ssize_t written = ::write(d_fd, data, left);
+          if (written < 0) {
+            return 0;
+          }
+          data += written;
+          left -= written;
+        }
+        Waiting waiting;
+        waiting.reply.tag = d_next_tag++;
+        waiting.reply.command = command;
+        waiting.sent = Clock::now();
+        d_waiting.push_back(waiting);
+        return waiting.reply.tag;
+      }
+
+      /**
+       * Read until some command's reply is complete, or timeout_ms passes. Returns if we got one.
+       */
+      bool
+      poll(
+          Reply *reply,
+          int timeout_ms) {
+        Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(timeout_ms);
+        for (;;) {
+          // Deal with whole lines we already have.
+          size_t end;
+          while ((end = d_in.find('\n')) != std::string::npos) {
+            std::string line = d_in.substr(0, end);
+            d_in.erase(0, end + 1);
+            if ( ! line.empty() && line.back() == '\r') {
+              line.pop_back();
+            }
+            if ( ! line.empty() && take_line(line, reply)) {
+              return true;
+            }
+          }
+
+          int left_ms = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count();
+          if (left_ms < 0 || ! read_some(left_ms)) {
+            return false;
+          }
+        }
+      }
+
+      /**
+       * Send a command and wait for its reply.
+       * Anything else still waiting is dealt with first, and its replies dropped.
+       */
+      bool
+      request(
+          const std::string &command,
+          Reply *reply,
+          int timeout_ms) {
+        uint32_t tag = send(command);
+        if ( ! tag) {
+          return false;
+        }
+        while (poll(reply, timeout_ms)) {
+          if (reply->tag == tag) {
+            return true;
+          }
+        }
+        return false;
+      }
+
+      /**
+       * How many commands are still waiting on a reply.
+       */
+      size_t
+      in_flight() const {
+        return d_waiting.size();
+      }
+
+      /**
+       * Forget about any commands still waiting, e.g. after a timeout.
+       */
+      void
+      abandon() {
+        d_waiting.clear();
+      }
+
+      /**
+       * Lines that weren't part of any reply, oldest first. Taking them clears the list.
+       */
+      std::vector<std::string>
+      take_unsolicited() {
+        std::vector<std::string> lines;
+        lines.swap(d_unsolicited);
+        return lines;
+      }
+
+      /**
+       * Round-trip latency of every reply so far.
+       */
+      Latency &
+      latency() {
+        return d_latency;
+      }
+
+      /**
+       * The host half of the device's BAUD handshake: propose the new rate, switch once the device
+       * acknowledges, and confirm at the new rate. If the confirmation doesn't come back within timeout_ms,
+       * we fall back to the old rate, as the device will after its own timeout.
+       * Nothing else should be in flight. Returns if we ended up at the new rate.
+       */
+      bool
+      negotiate_baud(
+          uint32_t baud,
+          int timeout_ms) {
+        uint32_t old_baud = d_baud;
+        Reply reply;
+        if ( ! request("BAUD " + std::to_string(baud), &reply, timeout_ms) || ! reply.ok) {
+          return false;
+        }
+        if ( ! set_baud(baud)) {
+          return false;  // Device will time out and come back to us.
+        }
+        if (request("BAUD CONFIRM", &reply, timeout_ms) && reply.ok) {
+          return true;
+        }
+        abandon();
+        set_baud(old_baud);
+        return false;
+      }
+
+    private:
+      struct Waiting {
+        Reply reply;
+        Clock::time_point sent;
+      };
+
+      static speed_t
+      to_speed(
+          uint32_t baud) {
+        switch (baud) {
+          case 1200: return B1200;
+          case 2400: return B2400;
+          case 4800: return B4800;
+          case 9600: return B9600;
+          case 19200: return B19200;
+          case 38400: return B38400;
+          case 57600: return B57600;
+          case 115200: return B115200;
+          case 230400: return B230400;
+#ifdef B460800
+          case 460800: return B460800;
+#endif
+#ifdef B921600
+          case 921600: return B921600;
+#endif
+#ifdef B1000000
+          case 1000000: return B1000000;
+#endif
+#ifdef B2000000
+          case 2000000: return B2000000;
+#endif
+          default: return B0;
+        }
+      }
+
+      /**
+       * Wait up to timeout_ms for more bytes. Returns false on timeout or error.
+       */
+      bool
+      read_some(
+          int timeout_ms) {
+        struct pollfd pfd = { d_fd, POLLIN, 0 };
+        if (::poll(&pfd, 1, timeout_ms) <= 0) {
+          return false;
+        }
+        char buf[512];
+        ssize_t got = ::read(d_fd, buf, sizeof(buf));
+        if (got <= 0) {
+          return false;
+        }
+        d_in.append(buf, got);
+        return true;
+      }
+
+      /**
+       * Deal with one line from the device. Returns true, filling in 'reply', if it completed a reply.
+       */
+      bool
+      take_line(
+          const std::string &line,
+          Reply *reply) {
+        bool ok = starts_with_word(line, "OK");
+        bool err = starts_with_word(line, "ERR");
+        if (d_waiting.empty()) {
+          d_unsolicited.push_back(line);
+          return false;
+        }
+        if ( ! ok && ! err) {
+          // Part of the reply to whatever is oldest.
+          d_waiting.front().reply.output.push_back(line);
+          return false;
+        }
+
+        bool usage = err && line.compare(0, 10, "ERR Usage:") == 0;
+        std::deque<Waiting>::iterator which = d_waiting.begin();
+        if (d_match == Match::NAME) {
+          // The command name is the word after "OK ", "ERR " or "ERR Usage: ".
+          std::string name = word_at(line, usage ? 10 : (ok ? 2 : 3));
+          for (std::deque<Waiting>::iterator it = d_waiting.begin(); it != d_waiting.end(); ++it) {
+            if (strcasecmp(word_at(it->reply.command, 0).c_str(), name.c_str()) == 0) {
+              which = it;
+              break;
+            }
+          }
+        }
+
+        *reply = which->reply;
+        reply->ok = ok;
+        reply->usage = usage;
+        reply->line = line;
+        reply->latency_us = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - which->sent).count();
+        d_latency.add(reply->latency_us);
+        d_waiting.erase(which);
+        return true;
+      }
+
+      static bool
+      starts_with_word(
+          const std::string &line,
+          const char *word) {
+        size_t len = strlen(word);
+        return line.compare(0, len, word) == 0 && (line.size() == len || line[len] == ' ');
+      }
+
+      /**
+       * The space-delimited word starting at or after 'pos'.
+       */
+      static std::string
+      word_at(
+          const std::string &line,
+          size_t pos) {
+        size_t start = line.find_first_not_of(' ', pos);
+        if (start == std::string::npos) {
+          return std::string();
+        }
+        size_t end = line.find(' ', start);
+        return line.substr(start, end == std::string::npos ? std::string::npos : end - start);
+      }
+
+      int d_fd;
+      uint32_t d_baud;
+      Match d_match;
+      uint32_t d_next_tag;
+      std::string d_in;  // Received but not yet split into lines.
+      std::deque<Waiting> d_waiting;
+      std::vector<std::string> d_unsolicited;
+      Latency d_latency;
+    };
+  } // namespace
+} // namespace
@@ -0,0 +1,107 @@
+/*
+ * lazy_loadgen - fire commands at a LazySerial device as fast as it will take them, and report round-trip latency.
+ *
+ * This file is part of the LazySerial library.
+ * Copyright (C) 2025 Lazy Cat Software <arduino@neko.stream>
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Build: g++ -std=c++11 -O2 -o lazy_loadgen lazy_loadgen.cpp
+ * Usage: lazy_loadgen [-b baud] [-B new_baud] [-n count] [-w window] [-t timeout_ms] [-N] <tty> [command]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "LazySerialClient.h"
+
+
+static void
+usage() {
+  fprintf(stderr,
+      "Usage: lazy_loadgen [options] <tty> [command]\n"
+      "  -b baud        rate to open the tty at (9600)\n"
+      "  -B new_baud    negotiate up to this rate with the BAUD command first\n"
+      "  -n count       how many commands to send (1000)\n"
+      "  -w window      how many to keep in flight at once (1)\n"
+      "  -t timeout_ms  how long to wait for a reply (2000)\n"
+      "  -N             match replies by command name rather than order\n"
+      "  command        what to send (PINOUT)\n");
+  exit(2);
+}
+
+
+int
+main(int argc, char **argv) {
+  uint32_t baud = 9600;
+  uint32_t new_baud = 0;
+  long count = 1000;
+  size_t window = 1;
+  int timeout_ms = 2000;
+  LazySerial::Host::Match match = LazySerial::Host::Match::ORDER;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "b:B:n:w:t:N")) != -1) {
+    switch (opt) {
+      case 'b': baud = strtoul(optarg, nullptr, 10); break;
+      case 'B': new_baud = strtoul(optarg, nullptr, 10); break;
+      case 'n': count = strtol(optarg, nullptr, 10); break;
+      case 'w': window = strtoul(optarg, nullptr, 10); break;
+      case 't': timeout_ms = atoi(optarg); break;
+      case 'N': match = LazySerial::Host::Match::NAME; break;
+      default: usage();
+    }
+  }
+  if (optind >= argc || window == 0) {
+    usage();
+  }
+  const char *path = argv[optind];
+  std::string command = (optind + 1 < argc) ? argv[optind + 1] : "PINOUT";
+
+  LazySerial::Host::Client client;
+  if ( ! client.open(path, baud)) {
+    perror(path);
+    return 1;
+  }
+  client.set_match(match);
+  if (new_baud && ! client.negotiate_baud(new_baud, timeout_ms)) {
+    fprintf(stderr, "Couldn't move to %u baud, staying at %u\n", new_baud, baud);
+  }
+
+  long sent = 0;
+  long ok = 0;
+  long failed = 0;
+  LazySerial::Host::Client::Clock::time_point start = LazySerial::Host::Client::Clock::now();
+  while (ok + failed < count) {
+    // Keep the pipeline topped up.
+    while (sent < count && client.in_flight() < window) {
+      if ( ! client.send(command)) {
+        perror("write");
+        return 1;
+      }
+      sent++;
+    }
+    LazySerial::Host::Reply reply;
+    if ( ! client.poll(&reply, timeout_ms)) {
+      fprintf(stderr, "Timed out with %zu in flight\n", client.in_flight());
+      failed += client.in_flight();
+      client.abandon();
+      continue;
+    }
+    if (reply.ok) {
+      ok++;
+    } else {
+      failed++;
+      if (failed == 1) {
+        fprintf(stderr, "First error: %s\n", reply.line.c_str());
+      }
+    }
+  }
+  double seconds = std::chrono::duration<double>(LazySerial::Host::Client::Clock::now() - start).count();
+
+  LazySerial::Host::Latency &latency = client.latency();
+  printf("%ld ok, %ld failed in %.3fs: %.1f commands/s\n", ok, failed, seconds, (ok + failed) / seconds);
+  printf("latency us: mean %.0f  p50 %u  p90 %u  p99 %u  max %u\n", latency.mean(),
+         latency.percentile(50), latency.percentile(90), latency.percentile(99), latency.percentile(100));
+  return failed ? 1 : 0;
+}
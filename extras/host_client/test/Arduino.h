@@ -0,0 +1,182 @@
+/*
+ * This file is part of the LazySerial library.
+ * Copyright (C) 2025 Lazy Cat Software <arduino@neko.stream>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+// Just enough of the Arduino core to build LazySerial and its example sketches on a POSIX host, for testing
+// them against the host client. Pins read back as LOW and go nowhere; Serial talks to a file descriptor.
+#include <poll.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+
+// ---------------- Flash ----------------
+#define PROGMEM
+#define PSTR(s) (s)
+#define pgm_read_byte(p) (*(const uint8_t *)(p))
+#define pgm_read_dword(p) (*(const uint32_t *)(p))
+#define strlen_P strlen
+#define memcpy_P memcpy
+class __FlashStringHelper;
+#define F(s) (reinterpret_cast<const __FlashStringHelper *>(PSTR(s)))
+
+
+// ---------------- Time ----------------
+inline uint32_t
+millis() {
+  using namespace std::chrono;
+  return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+inline uint32_t
+micros() {
+  using namespace std::chrono;
+  return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+inline void delay(uint32_t ms) { usleep(ms * 1000); }
+inline void delayMicroseconds(uint32_t us) { usleep(us); }
+inline void noInterrupts() {  }
+inline void interrupts() {  }
+
+
+// ---------------- Pins, laid out like an AVR: ports are numbered from 1, 8 pins each ----------------
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define INPUT_PULLDOWN 3
+#define LED_BUILTIN 13
+#define A0 14
+#define NUM_DIGITAL_PINS 20
+#define ARDUINO_BOARD "host"
+
+#define NOT_A_PIN 0
+#define NOT_A_PORT 0
+static volatile uint8_t host_ports[4];
+#define digitalPinToPort(p) ((p) < NUM_DIGITAL_PINS ? (p) / 8 + 1 : NOT_A_PIN)
+#define digitalPinToBitMask(p) (1 << ((p) % 8))
+#define portInputRegister(port) (&host_ports[port])
+#define portOutputRegister(port) (&host_ports[port])
+
+inline void pinMode(uint8_t, uint8_t) {  }
+inline void digitalWrite(uint8_t, uint8_t) {  }
+inline int digitalRead(uint8_t) { return LOW; }
+inline int analogRead(uint8_t) { return 0; }
+inline void tone(uint8_t, unsigned, unsigned long = 0) {  }
+inline void noTone(uint8_t) {  }
+
+
+// ---------------- Print / Stream ----------------
+class Print {
+public:
+  virtual ~Print() {  }
+  virtual size_t write(uint8_t) = 0;
+  virtual size_t
+  write(const uint8_t *buf, size_t n) {
+    size_t written = 0;
+    while (n--) {
+      written += write(*buf++);
+    }
+    return written;
+  }
+  size_t write(const char *s) { return write(reinterpret_cast<const uint8_t *>(s), strlen(s)); }
+  virtual void flush() {  }
+
+  size_t print(const char *s) { return write(s); }
+  size_t print(const __FlashStringHelper *s) { return write(reinterpret_cast<const char *>(s)); }
+  size_t print(char c) { return write(static_cast<uint8_t>(c)); }
+  size_t print(long n, int base = 10) { return printf(base == 16 ? "%lx" : "%ld", n); }
+  size_t print(int n, int base = 10) { return print(static_cast<long>(n), base); }
+  size_t print(unsigned long n, int base = 10) { return printf(base == 16 ? "%lx" : "%lu", n); }
+  size_t print(unsigned n, int base = 10) { return print(static_cast<unsigned long>(n), base); }
+  size_t print(uint8_t n, int base = 10) { return print(static_cast<unsigned long>(n), base); }
+  size_t print(double d, int digits = 2) { return printf("%.*f", digits, d); }
+  size_t println() { return write("\r\n"); }
+  template <typename T> size_t println(T t) { size_t n = print(t); return n + println(); }
+
+  template <typename... Args>
+  size_t
+  printf(const char *fmt, Args... args) {
+    char buf[64];
+    snprintf(buf, sizeof(buf), fmt, args...);
+    return write(buf);
+  }
+};
+
+class Stream : public Print {
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+};
+
+
+/**
+ * A Serial port on the end of a file descriptor, such as one end of a socketpair or a pty.
+ */
+class HardwareSerial : public Stream {
+public:
+  HardwareSerial() : d_fd(-1), d_peeked(-1) {  }
+
+  void attach(int fd) { d_fd = fd; d_peeked = -1; }
+  void begin(unsigned long) {  }
+
+  int
+  available() override {
+    if (d_peeked >= 0) {
+      return 1;
+    }
+    struct pollfd pfd = { d_fd, POLLIN, 0 };
+    unsigned char ch;
+    if (d_fd >= 0 && ::poll(&pfd, 1, 0) > 0 && ::read(d_fd, &ch, 1) == 1) {
+      d_peeked = ch;
+      return 1;
+    }
+    return 0;
+  }
+
+  int
+  read() override {
+    if ( ! available()) {
+      return -1;
+    }
+    int ch = d_peeked;
+    d_peeked = -1;
+    return ch;
+  }
+
+  int peek() override { return available() ? d_peeked : -1; }
+
+  size_t write(uint8_t ch) override { return write(&ch, 1); }
+
+  size_t
+  write(const uint8_t *buf, size_t n) override {
+    size_t written = 0;
+    while (d_fd >= 0 && written < n) {
+      ssize_t got = ::write(d_fd, buf + written, n - written);
+      if (got <= 0) {
+        break;
+      }
+      written += got;
+    }
+    return written;
+  }
+  using Print::write;
+
+private:
+  int d_fd;
+  int d_peeked;
+};
+
+static HardwareSerial Serial;
@@ -0,0 +1,126 @@
+/*
+ * smoke_test - run the pin_poker example on the host, against the Arduino.h stub alongside, and drive it with
+ * the host client over a socketpair.
+ *
+ * This file is part of the LazySerial library.
+ * Copyright (C) 2025 Lazy Cat Software <arduino@neko.stream>
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Build, from the top of the repository:
+ *   g++ -std=gnu++11 -Iextras/host_client/test -Isrc -Iexamples/pin_poker -o smoke_test \
+ *       extras/host_client/test/smoke_test.cpp -lpthread
+ * Exits non-zero if anything failed.
+ */
+#include <Arduino.h>
+#include <sys/socket.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+
+#include "pin_poker.ino"
+#include "../LazySerialClient.h"
+
+
+static int failures = 0;
+
+#define CHECK(X) check((X), #X, __LINE__)
+
+static void
+check(bool ok, const char *what, int line) {
+  if ( ! ok) {
+    fprintf(stderr, "FAIL line %d: %s\n", line, what);
+    failures++;
+  }
+}
+
+static bool
+has_line(const std::vector<std::string> &lines, const std::string &line) {
+  for (const std::string &candidate : lines) {
+    if (candidate == line) {
+      return true;
+    }
+  }
+  return false;
+}
+
+
+int
+main() {
+  int fds[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+    perror("socketpair");
+    return 1;
+  }
+  Serial.attach(fds[1]);
+  setup();
+  std::atomic<bool> stop(false);
+  std::thread device([&stop] {
+    while ( ! stop) {
+      loop();
+    }
+  });
+
+  LazySerial::Host::Client client;
+  client.adopt(fds[0]);
+  LazySerial::Host::Reply reply;
+
+  // The banner arrives with nothing waiting for it.
+  CHECK( ! client.poll(&reply, 100));
+  CHECK(has_line(client.take_unsolicited(), "OK STARTING"));
+
+  // lazy_loadgen's default command, which has to end in an OK line.
+  CHECK(client.request("PINOUT", &reply, 1000) && reply.ok);
+
+  // Bad args come back as usage.
+  CHECK(client.request("BLINK", &reply, 1000) && ! reply.ok && reply.usage);
+
+  // A pipelined burst, as lazy_loadgen -w 4 would send.
+  size_t ok = 0;
+  int sent = 0;
+  while (ok < 200) {
+    while (sent < 200 && client.in_flight() < 4) {
+      client.send("PINOUT");
+      sent++;
+    }
+    if ( ! client.poll(&reply, 1000)) {
+      break;
+    }
+    ok += reply.ok;
+  }
+  CHECK(ok == 200);
+  CHECK(client.latency().count() == 202);
+
+  // Replies paired up by name.
+  client.set_match(LazySerial::Host::Match::NAME);
+  uint32_t pinmode = client.send("PINMODE 3 OUTPUT");
+  uint32_t gpio = client.send("GPIO 3 ON");
+  CHECK(client.poll(&reply, 1000) && reply.tag == pinmode && reply.line == "OK PINMODE 3 OUTPUT");
+  CHECK(client.poll(&reply, 1000) && reply.tag == gpio && reply.line == "OK GPIO 3 ON");
+  client.set_match(LazySerial::Host::Match::ORDER);
+
+  // The BAUD handshake; rates don't mean anything on a socketpair, but the protocol still has to work.
+  CHECK(client.negotiate_baud(115200, 1000));
+
+  // Change-driven events turn up as unsolicited lines.
+  CHECK(client.request("WATCH 4", &reply, 1000) && reply.ok);
+  CHECK( ! client.poll(&reply, 100));
+  CHECK(has_line(client.take_unsolicited(), "EVENT 4 0"));
+  CHECK(client.request("UNWATCH ALL", &reply, 1000) && reply.ok);
+
+  // Pins the board doesn't have are usage errors, not garbage registers to read.
+  CHECK(client.request("CAPTURE PINS 300", &reply, 1000) && ! reply.ok && reply.usage);
+  CHECK(client.request("CAPTURE PINS 2 25", &reply, 1000) && ! reply.ok && reply.usage);
+  CHECK(client.request("CAPTURE TRIGGER RISE 25", &reply, 1000) && ! reply.ok && reply.usage);
+  CHECK(client.request("CAPTURE PINS 2 3 TRIGGER HIGH 4", &reply, 1000) && reply.ok);
+
+  stop = true;
+  device.join();
+  if (failures) {
+    fprintf(stderr, "%d failed\n", failures);
+    return 1;
+  }
+  printf("OK smoke_test\n");
+  return 0;
+}
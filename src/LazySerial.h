@@ -9,6 +9,8 @@
 
 #include "LazySerial/helpers.h"
 #include "LazySerial/Context.h"
+#include "LazySerial/Engine.h"
+#include "LazySerial/Watch.h"
 
 
 #define LAZYSERIAL_VERSION 2.0
@@ -22,7 +24,9 @@
     context.stream.println("ERR Usage: " NAME " " USAGESTR);     \
     return;                                                      \
   } else if (context.mode == LazySerial::CallingMode::INVOKE) {  \
-    if (strcasecmp(NAME, context.entered_command_name) != 0) {   \
+    enum { lazy_name_hash = ::LazySerial::name_hash(NAME) };     \
+    if (context.entered_command_hash != lazy_name_hash ||        \
+        strcasecmp(NAME, context.entered_command_name) != 0) {   \
       return;  /* not us. */                                     \
     }                                                            \
     context.mode = LazySerial::CallingMode::MATCHED;             \
@@ -36,20 +40,21 @@
 namespace LazySerial
 {
   /**
-   * The function pointer signature used for callbacks.
-   * It is necessary to pass the 'args' string as a non-const char *, since you will most likely want to
-   * use strtok() on it to further parse things.
+   * Just the command buffer. It's a base class of LazySerial, listed before Engine, so that it's there
+   * by the time Engine gets handed it.
    */
-  typedef void (*CallbackFunction)(Context &);
+  template <size_t BUF_SIZE>
+  struct BufferStorage {
+    char d_storage[BUF_SIZE];
+  };
+
 
   /**
-   * Function pointer signature for a generic character-reading source, for use with scripts saved to EEPROM.
+   * An Engine that brings its own BUF_SIZE command buffer. This is all there is to the template;
+   * everything else is shared by every size, in Engine.
    */
-  typedef char (*ReaderFunction)(size_t);
-  
-
   template <size_t BUF_SIZE>
-  class LazySerial {
+  class LazySerial : private BufferStorage<BUF_SIZE>, public Engine {
   public:
     /**
      * Constructor. Pass in the Stream to read and write from/to.
@@ -58,73 +63,22 @@ namespace LazySerial
     explicit
     LazySerial(
         Stream &stream) :
-      d_stream(stream),
-      d_help(NULL),
-      d_commands(nullptr),
-      d_commands_size(0) {
-      clear_buffer();
-    }
-    
-    /**
-     * Call this during setup() to set your array of LazySerial::CallbackFunction s
-     * Weird template magic allows us to deduce the size of array passed.
-     * Ref: https://cplusplus.com/articles/D4SGz8AR/
-     * "The way to prevent this conversion (known as 'decay') is to declare the function parameter as a reference to an array by changing fun(string s[N]) to fun(string (&s)[N])"
-     */
-    template <size_t S>
-    void
-    set_commands(
-        CallbackFunction (&commands)[S]) {
-      d_commands = commands;
-      d_commands_size = S;
-    }
-    
-    /**
-     * Call this from your own loop() for LazySerial to poll the Serial device for more data.
-     * Shouldn't delay for too long unless one of your callbacks ends up triggering and taking time to process.
-     */
-    void
-    loop() {
-      // Slowly assemble the command buffer byte by byte.
-      bool ready = assemble_command();
-      LAZY_RETURN_UNLESS(ready);
-      run_command();
-    }
+      BufferStorage<BUF_SIZE>(),
+      Engine(stream, this->d_storage, BUF_SIZE) {  }
 
-    
     /**
      * Instead of LazySerial polling the supplied Stream for commands, you can also supply a large string of
      * \n-terminated commands to run in a batch.
+     * Each line is put together in a BUF_SIZE buffer on the stack, leaving the command buffer alone, so this
+     * is fine to call from a command, or while a line is half-way in from the Stream.
      */
     void
     run_script(
         const char *script) {
-      const char *pos = script;
-      const char *end = script;
-      while (*pos) {
-        // starting from pos, search for a \n or \0.
-        end = pos;
-        while (*end && *end != '\n') {
-          end++;
-        }
-        // Copy the resulting line into the modifiable command buffer.
-        size_t length = end - pos;
-        if (length) {
-          length = MIN(length, BUF_SIZE-1);
-          strncpy(d_buf, pos, length);
-          d_buf[length] = '\0';
-
-          // Parse out the command and its arguments and run it!
-          run_command();
-        }
-        // Next line
-        if (*end) {
-          end++;
-        }
-        pos = end;
-      }
+      char line[BUF_SIZE];
+      Engine::run_script(script, line, BUF_SIZE);
     }
-    
+
     /**
      * Or a generic function to be called with an incrementing index until a '\0' is returned.
      * This lets me read from EEPROM without depending on EEPROM.h here.
@@ -132,177 +86,8 @@ namespace LazySerial
     void
     run_script(
         ReaderFunction read_char_fn) {
-      size_t pos = 0;
-      size_t this_cmd_pos = 0;
-      char ch = read_char_fn(pos);
-      while (ch) {
-        if (ch == '\n') {
-          // Reached newline, run this command rather than append '\n'.
-          d_buf[this_cmd_pos] = '\0';
-          run_command();
-          // Reset.
-          this_cmd_pos = 0;
-        } else {
-          // Copy into command buffer as we go.
-          d_buf[this_cmd_pos++] = ch;
-        }
-        // Read next ch
-        ch = read_char_fn(++pos);
-      }
-      // Reached \0, is there any leftover?
-      if (this_cmd_pos) {
-        d_buf[this_cmd_pos] = '\0';
-        run_command();
-      }
-    }
-
-    /**
-     * Dispatch the command named by 'cmd_name', to whatever callback has been registered by the user.
-     * If none match, cmd_help() will be invoked instead.
-     */
-    void
-    dispatch_command(
-        const char *cmd_name,
-        char *cmd_args ) {
-      // No-op command, helps in the case we are getting CRLF.
-      LAZY_RETURN_IF (cmd_name[0] == '\0');
-
-      // Scan through all registered callbacks.
-      for (uint8_t i = 0; i < d_commands_size; ++i) {
-        Context context{CallingMode::INVOKE, d_stream, cmd_name, cmd_args};
-        d_commands[i](context);
-        LAZY_RETURN_IF (context.mode == CallingMode::MATCHED);
-        if (context.mode == CallingMode::USAGE) {
-          // We matched the command but ran into problems parsing args.
-          // Call it again asking it to print its usage message.
-          d_commands[i](context);
-          return;
-        }
-      }
-      // Nothing matched. Print some help?
-      if (d_help) {
-        Context context{CallingMode::INVOKE, d_stream, "HELP", cmd_args};
-        d_help(context);
-      } else {
-        cmd_help();
-      }
-    }
-
-
-    /**
-     * The default help function.
-     * The magic HELP command is hard-coded to actually hit this method rather than anything in
-     * the function table, because we want access to our list of commands.
-     */
-    void
-    cmd_help() {
-      d_stream.print(F("ERR Available commands:"));
-      for (uint8_t i = 0; i < d_commands_size; ++i) {
-        d_stream.print(' ');
-        // Ask commands to name themselves.
-        Context context(CallingMode::IDENTIFY, d_stream);
-        d_commands[i](context);
-      }
-      d_stream.print(F(".\n"));
+      char line[BUF_SIZE];
+      Engine::run_script(read_char_fn, line, BUF_SIZE);
     }
-    /**
-     * Set an alternative callback when no command matches.
-     */
-    void
-    set_help_callback(
-        CallbackFunction cmd_help) {
-      d_help = cmd_help;
-    }
-
-  private:
-    void
-    clear_buffer() {
-      d_pos = 0;
-      d_buf[d_pos] = '\0';
-    }
-    
-    /**
-     * Read bytes from the serial until we get a \n.
-     * Returns true if we get one and have a completed command (with \0) in the buffer,
-     * false if we have yet to get a full command (or hit LAZYSERIAL_BUF_SIZE - no incomplete
-     * command will be processed)
-     */
-    bool
-    assemble_command() {
-      while (d_stream.available()) {
-        // Read new character
-        char ch = d_stream.read();
-        
-        // If it's the \n terminator, don't advance pos but instead write \0 and return success.
-        // Arduino seems to (correctly) interpret \n as 10, LF. Which is 'Newline' in the Serial Monitor.
-        // Minicom is being weird. Let's just support both CR and LF (and in the event we get both,
-        // interpret that as a regular command plus a no-op)
-        if (ch == 10 || ch == 13) {
-          d_buf[d_pos] = '\0';
-          return true;
-        }
-        
-        // For the mundane case, add the character to the buf and advance pos,
-        // keeping a \0 terminator just in case.
-        d_buf[d_pos] = ch;
-        d_pos++;
-        if (d_pos >= BUF_SIZE) {
-          // But if we're going to overflow, forget the whole damn thing.
-          clear_buffer();
-          return false;
-        }
-        d_buf[d_pos] = '\0';  // Just me being paranoid.
-      }
-      return false;
-    }
-    
-    /**
-     * Once the buffer is full, identify what command it is, parse and run it.
-     */
-    void
-    run_command() {
-      // Identify the command word. strchr is in <string.h>
-      char *end_of_cmd = strchr(d_buf, ' ');
-      char *cmd_name = d_buf;
-      char *cmd_args = d_buf;
-      if (end_of_cmd) {
-        // Set the delimiting space to a \0, advance args ptr to one past it.
-        end_of_cmd[0] = '\0';  // cmd_name will now be valid
-        end_of_cmd++;
-        cmd_args = end_of_cmd;
-      } else {
-        // No args. Put the 'args' pointer at the trailing \0 of the command itself, making args the empty string.
-        cmd_args = d_buf + strlen(d_buf);
-      }
-      
-      // Dispatch command!
-      dispatch_command(cmd_name, cmd_args);
-      // Clean up our buffer afterwards.
-      clear_buffer();
-    }
-    
-    /**
-     * What stream we are reading from / writing to.
-     */
-    Stream &d_stream;
-    
-    /**
-     * A statically declared list of callback functions.
-     */
-    CallbackFunction* d_commands;
-    uint8_t d_commands_size;
-  
-    /**
-     * Permit cmd_help to be overridden with something custom (and outside of this class).
-     */
-    CallbackFunction d_help;
-
-    /**
-     * Command Buffer, and our current position within it.
-     */
-    char d_buf[BUF_SIZE];
-    int  d_pos;
-    
   }; // class
 } //namespace
-
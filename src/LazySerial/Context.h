@@ -9,6 +9,9 @@
 
 #include "LazySerial/helpers.h"
 #include "LazySerial/parsing.h"
+#include "LazySerial/Keywords.h"
+#include "LazySerial/Response.h"
+#include "LazySerial/Tokens.h"
 
 
 namespace LazySerial
@@ -33,8 +36,10 @@ namespace LazySerial
       mode(m),
       stream(s),
       entered_command_name(nullptr),
+      entered_command_hash(0),
       args(nullptr),
-      pos(nullptr)  {  }
+      pos(nullptr),
+      tokens(nullptr)  {  }
 
     Context(
         CallingMode::CallingMode m,
@@ -44,8 +49,55 @@ namespace LazySerial
       mode(m),
       stream(s),
       entered_command_name(ecn),
+      entered_command_hash(name_hash(ecn)),
       args(a),
-      pos(a)  {  }
+      pos(a),
+      tokens(nullptr)  {  }
+
+    Context(
+        CallingMode::CallingMode m,
+        Stream &s,
+        const char *ecn,
+        char *a,
+        const Tokens &t):
+      mode(m),
+      stream(s),
+      entered_command_name(ecn),
+      entered_command_hash(t.name_hash),
+      args(a),
+      pos(a),
+      tokens(&t)  {  }
+
+
+    /**
+     * How many argument tokens were picked out as the command arrived (up to LAZYSERIAL_MAX_TOKENS).
+     */
+    uint8_t
+    token_count() const {
+      return tokens ? tokens->count : 0;
+    }
+
+    /**
+     * The start of the i'th whitespace-separated argument token, or nullptr.
+     * It's not \0-terminated, unless parse_word() or similar has been at it; tokens run up to the next space.
+     * Quotes aren't taken into account, so a quoted string with spaces in it will be split up.
+     */
+    char *
+    token(uint8_t i) const {
+      return (i < token_count()) ? args + tokens->starts[i] : nullptr;
+    }
+
+    /**
+     * Move pos to the start of the i'th argument token, so that the parse_*() methods can pick up from there.
+     * Returns false if there's no such token.
+     */
+    bool
+    seek_token(uint8_t i) {
+      char *start = token(i);
+      LAZY_RETURN_FALSE_UNLESS(start);
+      pos = start;
+      return true;
+    }
 
 
     /**
@@ -116,6 +168,91 @@ namespace LazySerial
       return true;
     }
 
+    /**
+     * Parse a run of integers into the array you supply, stopping at the end of args or at the next thing
+     * that doesn't start like a number. Numbers are separated by whitespace or commas, and may each be 0x hex.
+     * '*count' is set to how many we got.
+     * Returns if parsing went ok: at least one number, no more than 'max', none with junk on the end, and none
+     * that doesn't fit in T.
+     * Much quicker than a loop of parse_int() for a big table of values.
+     */
+    template<typename T>
+    bool
+    parse_int_array(T *dst, size_t max, size_t *count) {
+      size_t n = 0;
+      *count = 0;
+      for (;;) {
+        // Consume leading whitespace and separators.
+        while (*pos && (is_space(*pos) || *pos == ',')) {
+          pos++;
+        }
+        if ( ! ((*pos >= '0' && *pos <= '9') || *pos == '-' || *pos == '+')) {
+          break;
+        }
+        LAZY_RETURN_FALSE_IF(n >= max);
+
+        bool negative = (*pos == '-');
+        if (*pos == '-' || *pos == '+') {
+          pos++;
+        }
+        uint8_t base = 10;
+        if (is_hex_sigil(pos)) {
+          base = 16;
+          pos += 2;
+        }
+        char *start = pos;
+        unsigned long value = 0;
+        uint8_t digit;
+        while ((digit = hex_nibble(*pos)) < base) {
+          LAZY_RETURN_FALSE_IF(value > (ULONG_MAX - digit) / base);
+          value = value * base + digit;
+          pos++;
+        }
+        LAZY_RETURN_FALSE_UNLESS(pos > start);
+        LAZY_RETURN_FALSE_UNLESS(*pos == '\0' || is_space(*pos) || *pos == ',');
+        LAZY_RETURN_FALSE_UNLESS(fits_int<T>(negative, value));
+
+        dst[n++] = negative ? static_cast<T>(0UL - value) : static_cast<T>(value);
+        *count = n;
+      }
+      return n > 0;
+    }
+
+    /**
+     * Parse a blob of hex digits (an even number of them, optionally after a 0x) into the array you supply.
+     * '*len' is set to the number of bytes. Returns if parsing went ok, including fitting into 'max' bytes.
+     */
+    bool
+    parse_hex_bytes(uint8_t *dst, size_t max, size_t *len) {
+      char *start;
+      size_t digits;
+      LAZY_RETURN_FALSE_UNLESS(scan_hex_bytes(&start, &digits));
+      LAZY_RETURN_FALSE_IF(digits / 2 > max);
+      LAZY_RETURN_FALSE_UNLESS(decode_hex(start, dst, digits / 2));
+
+      *len = digits / 2;
+      pos = start + digits;
+      return true;
+    }
+
+    /**
+     * As above, but decodes the bytes in place within the args buffer, and sets the pointer you supply to them.
+     * Like parse_word(), this _**modifies**_ the args string, and they'll only be valid as long as it is.
+     */
+    bool
+    parse_hex_bytes(uint8_t **bytes_ptr, size_t *len) {
+      char *start;
+      size_t digits;
+      LAZY_RETURN_FALSE_UNLESS(scan_hex_bytes(&start, &digits));
+      uint8_t *bytes = reinterpret_cast<uint8_t *>(start);
+      LAZY_RETURN_FALSE_UNLESS(decode_hex(start, bytes, digits / 2));
+
+      *bytes_ptr = bytes;
+      *len = digits / 2;
+      pos = start + digits;
+      return true;
+    }
+
     /**
      * Parse into some float-like variable you supply by reference.
      * Returns if parsing went ok.
@@ -192,6 +329,29 @@ namespace LazySerial
     }
 
 
+    /**
+     * Parse the next word as one of the keywords in a KeywordTable, setting the index you supply by reference.
+     * Unlike parse_word(), this leaves the args string alone, and on failure pos is left at the start of the
+     * word so you can try parsing it as something else.
+     * Returns if parsing went ok.
+     */
+    bool
+    parse_keyword(const KeywordTable &table, uint8_t *index) {
+      // Consume leading whitespace.
+      parse_space();
+      char *end = pos;
+      while (*end && ! is_space(*end)) {
+        end++;
+      }
+      int8_t found = table.find(pos, end - pos);
+      LAZY_RETURN_FALSE_IF(found < 0);
+
+      *index = found;
+      pos = end;
+      return true;
+    }
+
+
     /**
      * Parse by setting the pointer-to-a-char* that you supply to the start of the string,
      * Like strtok, this _**modifies**_ the args string by inserting a \0 to terminate it.
@@ -237,12 +397,47 @@ namespace LazySerial
       return true;
     }
 
+    /**
+     * Start building a response line, to be written to the stream in one go with send().
+     */
+    Response
+    response() {
+      return Response(stream);
+    }
+
     
     CallingMode::CallingMode mode;
     Stream &stream;
     const char *entered_command_name;
+    uint16_t entered_command_hash;  // name_hash() of entered_command_name
     char *args;  // pointer into d_buf
     
     char *pos;   // pointer into args
+    const Tokens *tokens;  // Argument token positions, if known.
+
+  private:
+    /**
+     * Find the extent of the next word of hex digits for parse_hex_bytes(), skipping any 0x.
+     * There must be an even number of them; whether they are all actually hex is left to decode_hex().
+     */
+    bool
+    scan_hex_bytes(char **start_ptr, size_t *digits_ptr) {
+      parse_space();
+      LAZY_RETURN_FALSE_UNLESS(*pos);
+      char *start = pos;
+      if (is_hex_sigil(start)) {
+        start += 2;
+      }
+      char *end = start;
+      while (*end && ! is_space(*end)) {
+        end++;
+      }
+      size_t digits = end - start;
+      LAZY_RETURN_FALSE_IF(digits == 0 || digits % 2);
+
+      *start_ptr = start;
+      *digits_ptr = digits;
+      return true;
+    }
   }; // struct
 } // namespace
@@ -0,0 +1,643 @@
+/*
+ * This file is part of the LazySerial library.
+ * Copyright (C) 2025 Lazy Cat Software <arduino@neko.stream>
+ * 
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include <Arduino.h>
+
+#include "LazySerial/helpers.h"
+#include "LazySerial/Context.h"
+#include "LazySerial/Trace.h"
+
+
+// How long the BAUD command waits at a new rate for BAUD CONFIRM, before falling back to the old one.
+#ifndef LAZYSERIAL_BAUD_TIMEOUT_MS
+  #define LAZYSERIAL_BAUD_TIMEOUT_MS 2000
+#endif
+
+
+namespace LazySerial
+{
+  /**
+   * The function pointer signature used for callbacks.
+   * It is necessary to pass the 'args' string as a non-const char *, since you will most likely want to
+   * use strtok() on it to further parse things.
+   */
+  typedef void (*CallbackFunction)(Context &);
+
+  /**
+   * Function pointer signature for a generic character-reading source, for use with scripts saved to EEPROM.
+   */
+  typedef char (*ReaderFunction)(size_t);
+
+  /**
+   * Function pointer signature for switching the underlying serial port to a new baud rate,
+   * e.g. by calling Serial.begin(baud).
+   */
+  typedef void (*BaudFunction)(uint32_t);
+
+  /**
+   * Something that can keep everyone else off the Stream for a while, such as a LockedStream.
+   */
+  class StreamLock {
+  public:
+    virtual void lock() = 0;
+    virtual void unlock() = 0;
+
+  protected:
+    ~StreamLock() {  }
+  };
+  
+
+  /**
+   * Everything LazySerial does, working on a command buffer that belongs to someone else.
+   * This isn't templated on the buffer size, so however many differently-sized LazySerial<> objects there are,
+   * there's only ever the one copy of all this in flash.
+   */
+  class Engine {
+  public:
+    /**
+     * Constructor. Pass in the Stream to read and write from/to, and a buffer of 'capacity' chars to assemble
+     * commands in, which must outlive us. You'll usually want a LazySerial<BUF_SIZE>, which brings its own.
+     */
+    Engine(
+        Stream &stream,
+        char *buf,
+        size_t capacity) :
+      d_stream(stream),
+      d_commands(nullptr),
+      d_commands_size(0),
+      d_help(NULL),
+      d_baud_fn(nullptr),
+      d_baud(0),
+      d_baud_fallback(0),
+      d_baud_deadline(0),
+      d_stream_lock(nullptr),
+      d_buf(buf),
+      d_capacity(capacity) {
+      clear_buffer();
+    }
+
+    /**
+     * How long a command can be, including its \0.
+     */
+    size_t
+    capacity() const {
+      return d_capacity;
+    }
+    
+    /**
+     * Call this during setup() to set your array of LazySerial::CallbackFunction s
+     * Weird template magic allows us to deduce the size of array passed.
+     * Ref: https://cplusplus.com/articles/D4SGz8AR/
+     * "The way to prevent this conversion (known as 'decay') is to declare the function parameter as a reference to an array by changing fun(string s[N]) to fun(string (&s)[N])"
+     */
+    template <size_t S>
+    void
+    set_commands(
+        CallbackFunction (&commands)[S]) {
+      d_commands = commands;
+      d_commands_size = S;
+    }
+    
+    /**
+     * Call this from your own loop() for LazySerial to poll the Serial device for more data.
+     * Shouldn't delay for too long unless one of your callbacks ends up triggering and taking time to process.
+     */
+    void
+    loop() {
+      check_baud_timeout();
+      // Slowly assemble the command buffer byte by byte.
+      bool ready = assemble_command();
+      LAZY_RETURN_UNLESS(ready);
+      run_command();
+    }
+
+    
+    /**
+     * Dispatch the command named by 'cmd_name', to whatever callback has been registered by the user.
+     * If none match, cmd_help() will be invoked instead.
+     */
+    void
+    dispatch_command(
+        const char *cmd_name,
+        char *cmd_args ) {
+      Tokens tokens;
+      tokens.scan(cmd_name, cmd_args);
+      dispatch_command(cmd_name, cmd_args, tokens);
+    }
+
+    /**
+     * As above, but with the shape of the command already worked out: the name's hash, and args token positions.
+     */
+    void
+    dispatch_command(
+        const char *cmd_name,
+        char *cmd_args,
+        const Tokens &tokens) {
+      // No-op command, helps in the case we are getting CRLF.
+      LAZY_RETURN_IF (cmd_name[0] == '\0');
+#ifdef LAZYSERIAL_TRACE
+      if (strcasecmp(cmd_name, "TRACE") == 0) {
+        cmd_trace(cmd_args);
+        return;
+      }
+#endif
+      LAZY_TRACE(DISPATCH, Trace::NO_COMMAND, strlen(cmd_args));
+
+      // Scan through all registered callbacks.
+      for (uint8_t i = 0; i < d_commands_size; ++i) {
+        Context context{CallingMode::INVOKE, d_stream, cmd_name, cmd_args, tokens};
+        d_commands[i](context);
+        if (context.mode == CallingMode::MATCHED) {
+          LAZY_TRACE(FINISH, i, 0);
+          return;
+        }
+        if (context.mode == CallingMode::USAGE) {
+          // We matched the command but ran into problems parsing args.
+          // Call it again asking it to print its usage message.
+          LAZY_TRACE(USAGE, i, 0);
+          d_commands[i](context);
+          return;
+        }
+      }
+      // Nothing matched. Print some help?
+      LAZY_TRACE(HELP, Trace::NO_COMMAND, 0);
+      if (d_help) {
+        // Same args, but under HELP's name, so that the callback's LAZY_COMMAND("HELP") matches.
+        Tokens help_tokens = tokens;
+        help_tokens.name_hash = name_hash("HELP");
+        Context context{CallingMode::INVOKE, d_stream, "HELP", cmd_args, help_tokens};
+        d_help(context);
+      } else {
+        cmd_help();
+      }
+    }
+
+
+    /**
+     * The default help function.
+     * The magic HELP command is hard-coded to actually hit this method rather than anything in
+     * the function table, because we want access to our list of commands.
+     */
+    void
+    cmd_help() {
+      d_stream.print(F("ERR Available commands:"));
+      for (uint8_t i = 0; i < d_commands_size; ++i) {
+        d_stream.print(' ');
+        // Ask commands to name themselves.
+        Context context(CallingMode::IDENTIFY, d_stream);
+        d_commands[i](context);
+      }
+      if (d_baud_fn) {
+        d_stream.print(F(" BAUD"));
+      }
+#ifdef LAZYSERIAL_TRACE
+      d_stream.print(F(" TRACE"));
+#endif
+      d_stream.print(F(".\n"));
+    }
+
+    /**
+     * The built-in BAUD command, which moves the link to a new rate without risking lockout:
+     *   host: BAUD 115200          device: OK BAUD 115200, then switches
+     *   host switches too, then
+     *   host: BAUD CONFIRM         device: OK BAUD CONFIRM 115200
+     * If the confirmation doesn't turn up within LAZYSERIAL_BAUD_TIMEOUT_MS, the device goes back to the
+     * old rate; a host that doesn't see the OK should do the same.
+     * This is run by whoever is receiving commands (see run_baud()), never by an Executor's task, so that the
+     * baud state and the serial port are only ever touched from the one place.
+     */
+    void
+    cmd_baud(
+        char *cmd_args) {
+      Context context{CallingMode::INVOKE, d_stream, "BAUD", cmd_args};
+      if (d_baud_fallback) {
+        // Only the confirmation will do.
+        char *word;
+        LAZY_RETURN_UNLESS(context.parse_word(&word) && strcasecmp(word, "CONFIRM") == 0);
+        d_baud_fallback = 0;
+        context.response().str(F("OK BAUD CONFIRM ")).num(d_baud).send();
+        return;
+      }
+
+      uint32_t baud = 0;
+      if ( ! context.parse_int_minmax<uint32_t>(&baud, 300, 5000000)) {
+        d_stream.print(F("ERR Usage: BAUD <rate>|CONFIRM\n"));
+        return;
+      }
+      context.response().str(F("OK BAUD ")).num(baud).send();
+      d_baud_fallback = d_baud;
+      d_baud_deadline = millis() + LAZYSERIAL_BAUD_TIMEOUT_MS;
+      d_baud = baud;
+      switch_baud(baud);
+    }
+#ifdef LAZYSERIAL_TRACE
+    /**
+     * The built-in TRACE command, to dump the event trace, oldest first:
+     *   TRACE [TEXT]  a "TRACE <micros> <type> <command> <bytes>" line per event, then "OK TRACE <count>"
+     *   TRACE BIN     "OK TRACE BIN <count>", then the raw 8-byte little-endian Trace::Events
+     *   TRACE CLEAR
+     * Recording is paused while the dump goes out.
+     */
+    void
+    cmd_trace(
+        char *cmd_args) {
+      LAZY_KEYWORDS(keywords, "TEXT|BIN|CLEAR");
+      LAZY_KEYWORDS(type_names, LAZYSERIAL_TRACE_TYPE_NAMES);
+      enum { TEXT, BIN, CLEAR };
+      static_assert(sizeof(Trace::Event) == 8, "Trace::Event should pack into 8 bytes");
+      static_assert(LAZYSERIAL_TRACE_SIZE <= 255, "Trace::Buffer counts events in a uint8_t");
+
+      Context context{CallingMode::INVOKE, d_stream, "TRACE", cmd_args};
+      uint8_t keyword = TEXT;
+      context.parse_space();
+      if (*context.pos && ! context.parse_keyword(keywords, &keyword)) {
+        d_stream.print(F("ERR Usage: TRACE [TEXT|BIN|CLEAR]\n"));
+        return;
+      }
+
+      Trace::Buffer &trace = Trace::buffer();
+      trace.paused = true;
+      switch (keyword) {
+        case TEXT:
+          for (uint8_t i = 0; i < trace.count; ++i) {
+            const Trace::Event &event = Trace::event(i);
+            d_stream.print(F("TRACE "));
+            d_stream.print(event.micros);
+            d_stream.print(' ');
+            type_names.print(d_stream, event.type);
+            d_stream.print(' ');
+            if (event.command == Trace::NO_COMMAND) {
+              d_stream.print('-');
+            } else {
+              d_stream.print(event.command);
+            }
+            d_stream.print(' ');
+            d_stream.print(event.bytes);
+            d_stream.print('\n');
+          }
+          context.response().str(F("OK TRACE ")).num(trace.count).send();
+          break;
+        case BIN:
+          context.response().str(F("OK TRACE BIN ")).num(trace.count).send();
+          for (uint8_t i = 0; i < trace.count; ++i) {
+            d_stream.write(reinterpret_cast<const uint8_t *>(&Trace::event(i)), sizeof(Trace::Event));
+          }
+          break;
+        case CLEAR:
+          Trace::clear();
+          d_stream.print(F("OK TRACE CLEAR\n"));
+          break;
+      }
+      trace.paused = false;
+    }
+#endif
+
+    /**
+     * Set an alternative callback when no command matches.
+     */
+    void
+    set_help_callback(
+        CallbackFunction cmd_help) {
+      d_help = cmd_help;
+    }
+
+    /**
+     * Enable the built-in BAUD command, by supplying a function that can reconfigure the serial port
+     * and the baud rate it is running at right now.
+     */
+    void
+    set_baud_callback(
+        BaudFunction baud_fn,
+        uint32_t current_baud) {
+      d_baud_fn = baud_fn;
+      d_baud = current_baud;
+    }
+
+    /**
+     * If other tasks write to our Stream, supply the lock they share, and nobody will be writing while BAUD
+     * reconfigures the port. An Executor does this for you.
+     */
+    void
+    set_stream_lock(
+        StreamLock *lock) {
+      d_stream_lock = lock;
+    }
+
+    /**
+     * Poll the Stream like loop() does, but rather than running a completed command, copy it (with
+     * its \0) into 'line', which must have room for capacity() chars, and its shape into 'tokens'.
+     * Returns true if we got one.
+     * This lets commands be received here and run somewhere else, e.g. by an Executor.
+     */
+    bool
+    receive_command(
+        char *line,
+        Tokens *tokens) {
+      check_baud_timeout();
+      LAZY_RETURN_FALSE_UNLESS(assemble_command());
+      if (run_baud()) {
+        // Dealt with here, on the receiving side; nothing to hand over.
+        clear_buffer();
+        return false;
+      }
+      memcpy(line, d_buf, d_pos + 1);
+      *tokens = d_tokens;
+      clear_buffer();
+      return true;
+    }
+
+    /**
+     * Identify what command the \0-terminated 'line' is, parse and run it.
+     * The line will have a few '\0' characters jammed into it along the way.
+     */
+    void
+    run_line(
+        char *line) {
+      Tokens tokens;
+      tokens.scan(line);
+      run_line(line, tokens);
+    }
+
+    /**
+     * As above, but with the line's shape already worked out as it arrived, so there's nothing to scan for.
+     */
+    void
+    run_line(
+        char *line,
+        const Tokens &tokens) {
+      char *cmd_name = line;
+      char *cmd_args = line + tokens.name_end;
+      if (*cmd_args) {
+        // Set the delimiting space to a \0, advance args ptr to one past it.
+        *cmd_args = '\0';  // cmd_name will now be valid
+        cmd_args++;
+      }
+      // Otherwise no args; the 'args' pointer is at the trailing \0 of the command itself, making args the empty string.
+      
+      // Dispatch command!
+      dispatch_command(cmd_name, cmd_args, tokens);
+    }
+
+  protected:
+    /**
+     * A line of a script, being assembled somewhere other than the command buffer: that may be holding half a
+     * line from the Stream, or the line of the very command that is running the script.
+     */
+    struct ScriptLine {
+      char  *buf;
+      size_t capacity;
+      size_t pos;
+      bool   overrun;  // It didn't fit, so it's being skipped.
+      Tokens tokens;
+
+      ScriptLine(
+          char *b,
+          size_t c) :
+        buf(b),
+        capacity(c),
+        pos(0),
+        overrun(false) {
+        tokens.reset();
+      }
+    };
+
+    /**
+     * LazySerial<BUF_SIZE>::run_script(), with each line assembled in 'buf', of 'capacity' chars.
+     */
+    void
+    run_script(
+        const char *script,
+        char *buf,
+        size_t capacity) {
+      ScriptLine line(buf, capacity);
+      while (*script) {
+        script_char(line, *script++);
+      }
+      // The final command doesn't need a \n.
+      script_char(line, '\n');
+    }
+
+    void
+    run_script(
+        ReaderFunction read_char_fn,
+        char *buf,
+        size_t capacity) {
+      ScriptLine line(buf, capacity);
+      size_t pos = 0;
+      char ch = read_char_fn(pos);
+      while (ch) {
+        script_char(line, ch);
+        ch = read_char_fn(++pos);
+      }
+      script_char(line, '\n');
+    }
+
+  private:
+    Engine(const Engine &) = delete;
+    Engine &operator=(const Engine &) = delete;
+
+    /**
+     * If the command in the buffer is BAUD, run it. Returns true if the command has been dealt with: it was
+     * BAUD, or we are waiting for a new baud rate to be confirmed, and anything else is probably line noise.
+     */
+    bool
+    run_baud() {
+      LAZY_RETURN_FALSE_UNLESS(d_baud_fn);
+      if (d_tokens.name_hash == name_hash("BAUD") && d_tokens.name_end == 4 && strncasecmp(d_buf, "BAUD", 4) == 0) {
+        char *cmd_args = d_buf + d_tokens.name_end;
+        if (*cmd_args) {
+          *cmd_args = '\0';
+          cmd_args++;
+        }
+        cmd_baud(cmd_args);
+        return true;
+      }
+      return d_baud_fallback != 0;
+    }
+
+    /**
+     * If a new baud rate went unconfirmed for too long, go back to the old one.
+     */
+    void
+    check_baud_timeout() {
+      LAZY_RETURN_UNLESS(d_baud_fallback);
+      LAZY_RETURN_IF(static_cast<int32_t>(millis() - d_baud_deadline) < 0);
+      d_baud = d_baud_fallback;
+      d_baud_fallback = 0;
+      switch_baud(d_baud);
+      clear_buffer();  // Whatever we got at the wrong rate is garbage.
+      Response(d_stream).str(F("ERR BAUD TIMEOUT ")).num(d_baud).send();
+    }
+
+    /**
+     * Move the serial port to 'baud', once everything written at the old rate has gone out.
+     */
+    void
+    switch_baud(
+        uint32_t baud) {
+      if (d_stream_lock) {
+        d_stream_lock->lock();
+      }
+      d_stream.flush();
+      d_baud_fn(baud);
+      if (d_stream_lock) {
+        d_stream_lock->unlock();
+      }
+    }
+
+    void
+    clear_buffer() {
+      d_pos = 0;
+      d_buf[d_pos] = '\0';
+      d_tokens.reset();
+    }
+
+    /**
+     * Append a character to the command buffer, taking note of the command's shape as we go.
+     * Returns false, having dropped the character, if the buffer is full.
+     */
+    bool
+    store(
+        char ch) {
+      LAZY_RETURN_FALSE_IF(d_pos + 1 >= d_capacity);
+      d_buf[d_pos] = ch;
+      d_tokens.feed(ch, d_pos);
+      d_pos++;
+      d_buf[d_pos] = '\0';  // Just me being paranoid.
+      return true;
+    }
+
+    /**
+     * The command in the buffer is complete.
+     */
+    void
+    finish_line() {
+      d_buf[d_pos] = '\0';
+      d_tokens.finish(d_pos);
+    }
+    
+    /**
+     * Read bytes from the serial until we get a \n.
+     * Returns true if we get one and have a completed command (with \0) in the buffer,
+     * false if we have yet to get a full command (or hit LAZYSERIAL_BUF_SIZE - no incomplete
+     * command will be processed)
+     */
+    bool
+    assemble_command() {
+      while (d_stream.available()) {
+        // Read new character
+        char ch = d_stream.read();
+        
+        // If it's the \n terminator, don't advance pos but instead write \0 and return success.
+        // Arduino seems to (correctly) interpret \n as 10, LF. Which is 'Newline' in the Serial Monitor.
+        // Minicom is being weird. Let's just support both CR and LF (and in the event we get both,
+        // interpret that as a regular command plus a no-op)
+        if (ch == 10 || ch == 13) {
+          finish_line();
+          LAZY_TRACE(RECEIVE, Trace::NO_COMMAND, d_pos);
+          return true;
+        }
+        
+        // For the mundane case, add the character to the buf and advance pos, noting where the command name
+        // and args tokens are as they go past so that there's no need to scan for them later.
+        if ( ! store(ch)) {
+          // But if we're going to overflow, forget the whole damn thing.
+          LAZY_TRACE(OVERRUN, Trace::NO_COMMAND, d_pos);
+          clear_buffer();
+          return false;
+        }
+      }
+      return false;
+    }
+    
+    /**
+     * Add the next character of a script to 'line', and run the line when its \n turns up. As with the Stream,
+     * a line that doesn't fit is dropped, rather than run cut short. Lines go straight to run_line(), so BAUD
+     * isn't available to scripts; that's between the host and whoever is receiving.
+     */
+    void
+    script_char(
+        ScriptLine &line,
+        char ch) {
+      if (ch != '\n') {
+        if (line.pos + 1 < line.capacity) {
+          line.buf[line.pos] = ch;
+          line.tokens.feed(ch, line.pos);
+          line.pos++;
+        } else {
+          line.overrun = true;
+        }
+        return;
+      }
+      line.buf[line.pos] = '\0';
+      line.tokens.finish(line.pos);
+      if (line.overrun) {
+        LAZY_TRACE(OVERRUN, Trace::NO_COMMAND, line.pos);
+      } else {
+        run_line(line.buf, line.tokens);
+      }
+      line.pos = 0;
+      line.overrun = false;
+      line.tokens.reset();
+    }
+
+    /**
+     * Once the buffer is full, identify what command it is, parse and run it.
+     */
+    void
+    run_command() {
+      if ( ! run_baud()) {
+        run_line(d_buf, d_tokens);
+      }
+      // Clean up our buffer afterwards.
+      clear_buffer();
+    }
+    
+    /**
+     * What stream we are reading from / writing to.
+     */
+    Stream &d_stream;
+    
+    /**
+     * A statically declared list of callback functions.
+     */
+    CallbackFunction* d_commands;
+    uint8_t d_commands_size;
+  
+    /**
+     * Permit cmd_help to be overridden with something custom (and outside of this class).
+     */
+    CallbackFunction d_help;
+
+    /**
+     * Baud rate negotiation: how to change rate, the rate we're at, and while a new rate awaits
+     * confirmation, the rate to fall back to (0 otherwise) and when.
+     */
+    BaudFunction d_baud_fn;
+    uint32_t d_baud;
+    uint32_t d_baud_fallback;
+    uint32_t d_baud_deadline;
+
+    /**
+     * Held while the baud rate changes, if other tasks share the Stream.
+     */
+    StreamLock *d_stream_lock;
+
+    /**
+     * Command Buffer, its size, and our current position within it.
+     */
+    char  *d_buf;
+    size_t d_capacity;
+    size_t d_pos;
+
+    /**
+     * The shape of the command in d_buf, worked out as it arrives.
+     */
+    Tokens d_tokens;
+    
+  }; // class
+} // namespace
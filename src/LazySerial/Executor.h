@@ -0,0 +1,398 @@
+/*
+ * This file is part of the LazySerial library.
+ * Copyright (C) 2025 Lazy Cat Software <arduino@neko.stream>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include <Arduino.h>
+
+#if defined(ESP32)
+  #include <freertos/FreeRTOS.h>
+  #include <freertos/task.h>
+#elif defined(__has_include)
+  #if __has_include(<thread>)
+    #include <thread>
+  #else
+    #error "LazySerial/Executor.h needs FreeRTOS (ESP32) or std::thread"
+  #endif
+#else
+  #error "LazySerial/Executor.h needs FreeRTOS (ESP32) or std::thread"
+#endif
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+#include "LazySerial.h"
+
+// Which core the executor task is pinned to on ESP32. Arduino's own loop() runs on core 1.
+#ifndef LAZYSERIAL_EXECUTOR_CORE
+  #define LAZYSERIAL_EXECUTOR_CORE 0
+#endif
+#ifndef LAZYSERIAL_EXECUTOR_STACK
+  #define LAZYSERIAL_EXECUTOR_STACK 4096
+#endif
+#ifndef LAZYSERIAL_EXECUTOR_PRIORITY
+  #define LAZYSERIAL_EXECUTOR_PRIORITY 1
+#endif
+
+
+namespace LazySerial
+{
+  /**
+   * A Stream wrapper that serialises output from several tasks, a line at a time.
+   * Every write takes a (recursive) lock, and a task that leaves a line unfinished keeps it until it writes the
+   * '\n', so a response put together from several prints comes out in one piece, but nobody waits on anything
+   * longer than a line. Hold a Guard to keep several lines together. Reads pass straight through, as only the
+   * receiving side should be doing those.
+   */
+  class LockedStream : public Stream, public StreamLock {
+  public:
+    explicit
+    LockedStream(
+        Stream &stream) :
+      d_stream(stream) {  }
+
+    /**
+     * Holds the output lock for as long as it is in scope.
+     */
+    class Guard {
+    public:
+      explicit
+      Guard(
+          LockedStream &locked) :
+        d_locked(locked) {
+        d_locked.lock();
+      }
+
+      ~Guard() {
+        d_locked.unlock();
+      }
+
+    private:
+      Guard(const Guard &) = delete;
+      Guard &operator=(const Guard &) = delete;
+
+      LockedStream &d_locked;
+    };
+
+    void
+    lock() {
+      d_mutex.lock();
+    }
+
+    void
+    unlock() {
+      d_mutex.unlock();
+    }
+
+    int
+    available() {
+      return d_stream.available();
+    }
+
+    int
+    read() {
+      return d_stream.read();
+    }
+
+    int
+    peek() {
+      return d_stream.peek();
+    }
+
+    size_t
+    write(
+        uint8_t ch) {
+      Guard guard(*this);
+      size_t written = d_stream.write(ch);
+      hold_line(ch != '\n');
+      return written;
+    }
+
+    size_t
+    write(
+        const uint8_t *buf,
+        size_t size) {
+      Guard guard(*this);
+      size_t written = d_stream.write(buf, size);
+      if (size) {
+        hold_line(buf[size - 1] != '\n');
+      }
+      return written;
+    }
+    using Print::write;
+
+    void
+    flush() {
+      Guard guard(*this);
+      d_stream.flush();
+    }
+
+    /**
+     * Give up a line we left unfinished, e.g. after some binary output that doesn't end in '\n'.
+     */
+    void
+    end_line() {
+      Guard guard(*this);
+      hold_line(false);
+    }
+
+  private:
+    /**
+     * With the lock held, keep hold of it past the current write if the line isn't finished, or let go of
+     * the hold if it is. Only the task holding the lock can be in the middle of a line.
+     */
+    void
+    hold_line(
+        bool hold) {
+      if (hold != d_in_line) {
+        d_in_line = hold;
+        if (hold) {
+          d_mutex.lock();
+        } else {
+          d_mutex.unlock();
+        }
+      }
+    }
+
+    Stream &d_stream;
+    std::recursive_mutex d_mutex;
+    bool d_in_line = false;  // Someone has the lock for the rest of a line.
+  }; // class
+
+
+  /**
+   * Runs commands on a task of their own, so that slow commands don't hold up the main loop().
+   * The main loop() keeps receiving bytes and hands each completed command over through a bounded queue
+   * of QUEUE_SIZE lines; the executor task runs them one at a time, in order.
+   *
+   * The LazySerial object should be talking to a LockedStream, so that responses from the two sides come out
+   * a whole line at a time, without either side waiting on the other for any longer than that.
+   * Commands run on the executor task may run_script() or dispatch_command(): neither touches the command
+   * buffer the receiving side is assembling lines in, nor the baud rate, which only the receiving side changes.
+   */
+  template <size_t BUF_SIZE, size_t QUEUE_SIZE = 4>
+  class Executor {
+  public:
+    /**
+     * Each queued command is given an ascending ticket number, which can be used to check on it later.
+     * 0 is never a valid ticket.
+     */
+    typedef uint32_t Ticket;
+
+    /**
+     * Taking the LazySerial<BUF_SIZE> itself makes sure our slots are big enough for anything it receives;
+     * after that, it's only the Engine we need.
+     */
+    Executor(
+        LazySerial<BUF_SIZE> &lazy,
+        LockedStream &stream) :
+      d_lazy(lazy),
+      d_stream(stream),
+      d_submitted(0),
+      d_completed(0),
+      d_stop(false),
+      d_running(false) {
+      // So that BAUD doesn't pull the port out from under a response on the executor task.
+      d_lazy.set_stream_lock(&d_stream);
+    }
+
+    /**
+     * Stops the executor task once any command it is running finishes, and waits for it to go.
+     */
+    ~Executor() {
+      std::unique_lock<std::mutex> lock(d_mutex);
+      d_stop = true;
+      d_changed.notify_all();
+#if defined(ESP32)
+      // The task says when it's done with us, from task_entry().
+      d_changed.wait(lock, [this] { return ! d_running; });
+#else
+      lock.unlock();
+      if (d_thread.joinable()) {
+        d_thread.join();
+      }
+#endif
+    }
+
+    /**
+     * Call this during setup(), after set_commands(), to start the executor task.
+     */
+    void
+    begin() {
+#if defined(ESP32)
+      d_running = true;
+      if (xTaskCreatePinnedToCore(task_entry, "LazySerial", LAZYSERIAL_EXECUTOR_STACK, this,
+                                  LAZYSERIAL_EXECUTOR_PRIORITY, nullptr, LAZYSERIAL_EXECUTOR_CORE) != pdPASS) {
+        d_running = false;
+      }
+#else
+      d_thread = std::thread(&Executor::run, this);
+#endif
+    }
+
+    /**
+     * Call this from your own loop() instead of the LazySerial's loop().
+     * Polls the Stream for more data, and queues any completed command. Returns its Ticket, or 0 if
+     * nothing was queued. While the queue is full we stop reading, leaving bytes waiting in the Stream.
+     */
+    Ticket
+    loop() {
+      Slot *slot = free_slot();
+      if ( ! slot || ! d_lazy.receive_command(slot->line, &slot->tokens)) {
+        return 0;
+      }
+      return push();
+    }
+
+    /**
+     * Queue up a command from some other source. As with loop(), this should only be called from the
+     * receiving side. Returns its Ticket, or 0 if the queue is full.
+     */
+    Ticket
+    submit(
+        const char *command) {
+      Slot *slot = free_slot();
+      if ( ! slot) {
+        return 0;
+      }
+      strncpy(slot->line, command, BUF_SIZE - 1);
+      slot->line[BUF_SIZE - 1] = '\0';
+      slot->tokens.scan(slot->line);
+      return push();
+    }
+
+    /**
+     * Has the command with this ticket finished running?
+     */
+    bool
+    done(
+        Ticket ticket) {
+      std::lock_guard<std::mutex> lock(d_mutex);
+      return is_done(ticket);
+    }
+
+    /**
+     * Block until the command with this ticket has finished running, or timeout_ms passes.
+     * Returns whether it finished.
+     */
+    bool
+    wait(
+        Ticket ticket,
+        uint32_t timeout_ms) {
+      std::unique_lock<std::mutex> lock(d_mutex);
+      return d_changed.wait_for(lock, std::chrono::milliseconds(timeout_ms), [this, ticket] { return is_done(ticket); });
+    }
+
+    /**
+     * How many commands are queued or running.
+     */
+    size_t
+    pending() {
+      std::lock_guard<std::mutex> lock(d_mutex);
+      return d_submitted - d_completed;
+    }
+
+  private:
+    /**
+     * A queued command, and its shape as worked out when it arrived.
+     */
+    struct Slot {
+      char line[BUF_SIZE];
+      Tokens tokens;
+    };
+
+    Executor(const Executor &) = delete;
+    Executor &operator=(const Executor &) = delete;
+
+    bool
+    is_done(
+        Ticket ticket) {
+      return ticket && static_cast<int32_t>(d_completed - ticket) >= 0;
+    }
+
+    /**
+     * The slot the next command should be written to, or nullptr if the queue is full.
+     * Only the receiving side ever writes to it, and the executor won't look at it until push().
+     */
+    Slot *
+    free_slot() {
+      std::lock_guard<std::mutex> lock(d_mutex);
+      if (d_submitted - d_completed >= QUEUE_SIZE) {
+        return nullptr;
+      }
+      return &d_slots[d_submitted % QUEUE_SIZE];
+    }
+
+    Ticket
+    push() {
+      Ticket ticket;
+      {
+        std::lock_guard<std::mutex> lock(d_mutex);
+        ticket = ++d_submitted;
+      }
+      d_changed.notify_all();
+      return ticket;
+    }
+
+#if defined(ESP32)
+    static void
+    task_entry(
+        void *executor) {
+      Executor *self = static_cast<Executor *>(executor);
+      self->run();
+      {
+        // Once this is seen, the destructor may go ahead, so we mustn't touch 'self' again after the lock goes.
+        std::lock_guard<std::mutex> lock(self->d_mutex);
+        self->d_running = false;
+        self->d_changed.notify_all();
+      }
+      vTaskDelete(nullptr);
+    }
+#endif
+
+    /**
+     * The executor task itself. Commands are run in place in their slot, which isn't handed back to the
+     * receiving side until the command completes.
+     */
+    void
+    run() {
+      for (;;) {
+        Slot *slot;
+        {
+          std::unique_lock<std::mutex> lock(d_mutex);
+          d_changed.wait(lock, [this] { return d_stop || d_submitted != d_completed; });
+          LAZY_RETURN_IF(d_stop);
+          slot = &d_slots[d_completed % QUEUE_SIZE];
+        }
+        d_lazy.run_line(slot->line, slot->tokens);
+        // Don't keep the console from everyone else if the command left a line unfinished.
+        d_stream.end_line();
+        {
+          std::lock_guard<std::mutex> lock(d_mutex);
+          d_completed++;
+        }
+        d_changed.notify_all();
+      }
+    }
+
+    Engine &d_lazy;
+    LockedStream &d_stream;
+
+    /**
+     * The queue itself: tickets d_completed+1 .. d_submitted are waiting in slots indexed by ticket number.
+     */
+    Slot d_slots[QUEUE_SIZE];
+    Ticket d_submitted;
+    Ticket d_completed;
+    bool d_stop;
+    bool d_running;  // Whether the executor task has been started and not yet finished (ESP32 only).
+
+    std::mutex d_mutex;
+    std::condition_variable d_changed;
+#if ! defined(ESP32)
+    std::thread d_thread;
+#endif
+  }; // class
+} // namespace
@@ -0,0 +1,111 @@
+/*
+ * This file is part of the LazySerial library.
+ * Copyright (C) 2025 Lazy Cat Software <arduino@neko.stream>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include <Arduino.h>
+
+#include "LazySerial/parsing.h"
+
+
+/**
+ * Declare a KeywordTable called NAME, with its words kept in flash.
+ * WORDS is a string literal of '|'-separated keywords, e.g. "PIN|FPS|OFF". If you #define that string, it can
+ * go straight into your LAZY_COMMAND() usage text too.
+ */
+#define LAZY_KEYWORDS(NAME, WORDS)                              \
+  static const char NAME##_words[] PROGMEM = WORDS;             \
+  static const ::LazySerial::KeywordTable NAME(NAME##_words)
+
+
+namespace LazySerial
+{
+  /**
+   * A set of keywords for subcommands, kept in flash as one '|'-separated string.
+   * Matching ignores case, and accepts any unambiguous prefix ("DIG" for "DIGITAL"), though an exact match
+   * always wins ("INPUT" even with "INPUT_PULLUP" about). Keywords are identified by their index in the string.
+   * Tables are small enough in practice that a scan straight through the flash string beats anything cleverer.
+   */
+  class KeywordTable {
+  public:
+    /**
+     * 'words' must point to a PROGMEM string, as declared by LAZY_KEYWORDS().
+     */
+    explicit
+    KeywordTable(
+        const char *words) :
+      d_words(words)  {  }
+
+    /**
+     * Find the keyword matching the 'len' chars at 'word'.
+     * Returns its index, or -1 if there is none or the prefix is ambiguous.
+     */
+    int8_t
+    find(const char *word, size_t len) const {
+      if (len == 0) {
+        return -1;
+      }
+      int8_t found = -1;
+      bool ambiguous = false;
+      const char *keyword = d_words;
+      for (int8_t index = 0; ; ++index) {
+        // How much of this keyword matches?
+        size_t i = 0;
+        char ch = pgm_read_byte(keyword);
+        while (i < len && ch && ch != '|' && fold_case(ch) == fold_case(word[i])) {
+          ch = pgm_read_byte(keyword + ++i);
+        }
+        if (i == len) {
+          if (ch == '|' || ch == '\0') {
+            return index;  // Exact match.
+          }
+          ambiguous = (found != -1);
+          found = index;
+        }
+        // Skip to the next keyword.
+        while (ch && ch != '|') {
+          ch = pgm_read_byte(keyword + ++i);
+        }
+        if ( ! ch) {
+          break;
+        }
+        keyword += i + 1;
+      }
+      return ambiguous ? -1 : found;
+    }
+
+    /**
+     * Print the table as it would appear in a usage message, "(PIN|FPS|OFF)".
+     */
+    void
+    print(Print &out) const {
+      out.print('(');
+      out.print(reinterpret_cast<const __FlashStringHelper *>(d_words));
+      out.print(')');
+    }
+
+    /**
+     * Print just the keyword at 'index', e.g. to echo back the full name of an abbreviation.
+     */
+    void
+    print(Print &out, uint8_t index) const {
+      const char *keyword = d_words;
+      char ch = pgm_read_byte(keyword);
+      while (index && ch) {
+        if (ch == '|') {
+          index--;
+        }
+        ch = pgm_read_byte(++keyword);
+      }
+      while (ch && ch != '|') {
+        out.print(ch);
+        ch = pgm_read_byte(++keyword);
+      }
+    }
+
+  private:
+    const char *d_words;
+  }; // class
+} // namespace
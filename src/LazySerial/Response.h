@@ -0,0 +1,313 @@
+/*
+ * This file is part of the LazySerial library.
+ * Copyright (C) 2025 Lazy Cat Software <arduino@neko.stream>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include <Arduino.h>
+#include <math.h>  // isnan, isinf
+
+#include "LazySerial/helpers.h"
+#include "LazySerial/Trace.h"
+
+
+// How many bytes of response are built up on the stack before they need to be written out.
+#ifndef LAZYSERIAL_RESPONSE_SIZE
+  #define LAZYSERIAL_RESPONSE_SIZE 64
+#endif
+
+
+namespace LazySerial
+{
+  /**
+   * "00" "01" ... "99", so that numbers can be formatted two digits per division.
+   */
+  static const char DIGIT_PAIRS[] PROGMEM =
+    "00010203040506070809" "10111213141516171819" "20212223242526272829" "30313233343536373839"
+    "40414243444546474849" "50515253545556575859" "60616263646566676869" "70717273747576777879"
+    "80818283848586878889" "90919293949596979899";
+
+  static const char HEX_DIGITS[] PROGMEM = "0123456789ABCDEF";
+
+  static const uint32_t POWERS_OF_TEN[] PROGMEM = {
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000,
+  };
+
+  /**
+   * 10^n, for n up to 9, read out of flash.
+   */
+  inline
+  uint32_t
+  power_of_ten(uint8_t n) {
+    return pgm_read_dword(&POWERS_OF_TEN[n]);
+  }
+
+
+  /**
+   * Which types Response::num() takes: integers, but not bool, and nothing wider than the unsigned long it
+   * formats with.
+   */
+  template <typename T> struct IsInteger { enum { value = false }; };
+  template <> struct IsInteger<char> { enum { value = true }; };
+  template <> struct IsInteger<signed char> { enum { value = true }; };
+  template <> struct IsInteger<unsigned char> { enum { value = true }; };
+  template <> struct IsInteger<short> { enum { value = true }; };
+  template <> struct IsInteger<unsigned short> { enum { value = true }; };
+  template <> struct IsInteger<int> { enum { value = true }; };
+  template <> struct IsInteger<unsigned int> { enum { value = true }; };
+  template <> struct IsInteger<long> { enum { value = true }; };
+  template <> struct IsInteger<unsigned long> { enum { value = true }; };
+  template <> struct IsInteger<long long> { enum { value = sizeof(long long) <= sizeof(unsigned long) }; };
+  template <> struct IsInteger<unsigned long long> { enum { value = sizeof(long long) <= sizeof(unsigned long) }; };
+
+
+  /**
+   * Builds up a line of response in a small buffer, and writes it out in one go with send().
+   * Much cheaper than a chain of Stream::print() calls, each of which is a virtual call, and whose number
+   * formatting divides by 10 for every digit.
+   * Everything returns the Response again, so calls can be chained:
+   *
+   *   context.response().str(F("OK PIN ")).num(pin).keyval(F("value"), val).send();
+   *
+   * Should a response outgrow the buffer, what we have so far gets written out early.
+   */
+  class Response {
+  public:
+    explicit
+    Response(
+        Print &out) :
+      d_out(out),
+      d_len(0)  {  }
+
+    Response &
+    ch(char c) {
+      reserve(1);
+      d_buf[d_len++] = c;
+      return *this;
+    }
+
+    Response &
+    str(const char *s) {
+      while (*s) {
+        reserve(1);
+        d_buf[d_len++] = *s++;
+      }
+      return *this;
+    }
+
+    Response &
+    str(const __FlashStringHelper *fs) {
+      const char *s = reinterpret_cast<const char *>(fs);
+      char c;
+      while ((c = pgm_read_byte(s++))) {
+        reserve(1);
+        d_buf[d_len++] = c;
+      }
+      return *this;
+    }
+
+    /**
+     * Any integer type, in decimal. Use flt() or fixed() for anything else.
+     */
+    template<typename T>
+    Response &
+    num(T n) {
+      static_assert(IsInteger<T>::value, "Response::num() is for integers; bools and floats need ch(), flt() or fixed()");
+      if (n < 0) {
+        ch('-');
+        // Negate as unsigned, so that the most negative value still works.
+        return digits(0UL - static_cast<unsigned long>(n));
+      }
+      return digits(static_cast<unsigned long>(n));
+    }
+
+    /**
+     * Uppercase hex, zero-padded to at least min_digits. No 0x sigil, add it yourself if you want it.
+     */
+    Response &
+    hex(uint32_t n, uint8_t min_digits = 1) {
+      char tmp[8];
+      uint8_t count = 0;
+      do {
+        tmp[count++] = pgm_read_byte(&HEX_DIGITS[n & 0xF]);
+        n >>= 4;
+      } while (n || (count < min_digits && count < sizeof(tmp)));
+      reserve(count);
+      while (count) {
+        d_buf[d_len++] = tmp[--count];
+      }
+      return *this;
+    }
+
+    /**
+     * A fixed-point number, stored as an integer scaled by 10^decimals: fixed(-1234, 2) gives "-12.34"
+     */
+    Response &
+    fixed(long n, uint8_t decimals) {
+      decimals = MIN(decimals, 9);
+      unsigned long magnitude = n;
+      if (n < 0) {
+        ch('-');
+        magnitude = 0UL - magnitude;
+      }
+      uint32_t scale = power_of_ten(decimals);
+      digits(magnitude / scale);
+      return fraction(magnitude % scale, decimals);
+    }
+
+    /**
+     * A float, rounded to some number of decimal places. Like Print, gives up with "ovf" on anything huge.
+     */
+    Response &
+    flt(double value, uint8_t decimals = 2) {
+      decimals = MIN(decimals, 9);
+      if (isnan(value)) {
+        return str(F("nan"));
+      }
+      if (isinf(value)) {
+        return str(F("inf"));
+      }
+      if (value < 0) {
+        ch('-');
+        value = -value;
+      }
+      if (value > 4294967040.0) {
+        return str(F("ovf"));
+      }
+
+      // Integer part, then the fraction as an integer, rounding half up.
+      uint32_t scale = power_of_ten(decimals);
+      unsigned long whole = value;
+      double scaled = (value - whole) * scale + 0.5;
+      unsigned long frac = scaled;
+      if (frac >= scale) {
+        // Rounding carried into the integer part, e.g. 0.999 to 2 places.
+        whole++;
+        frac -= scale;
+      }
+      digits(whole);
+      return fraction(frac, decimals);
+    }
+
+    /**
+     * " key=value", in the style of LAZY_KEYVAL(). The value can be an integer, or a string.
+     */
+    template<typename K, typename T>
+    Response &
+    keyval(K key, T value) {
+      ch(' ');
+      str(key);
+      ch('=');
+      return num(value);
+    }
+
+    template<typename K>
+    Response &
+    keyval(K key, const char *value) {
+      ch(' ');
+      str(key);
+      ch('=');
+      return str(value);
+    }
+
+    template<typename K>
+    Response &
+    keyval(K key, char *value) {
+      return keyval(key, const_cast<const char *>(value));
+    }
+
+    /**
+     * Bytes as a run of uppercase hex pairs, e.g. "DEADBEEF".
+     */
+    Response &
+    hexdump(const uint8_t *data, size_t len) {
+      while (len--) {
+        reserve(2);
+        d_buf[d_len++] = pgm_read_byte(&HEX_DIGITS[*data >> 4]);
+        d_buf[d_len++] = pgm_read_byte(&HEX_DIGITS[*data & 0xF]);
+        data++;
+      }
+      return *this;
+    }
+
+    /**
+     * Finish the line with a '\n' and write it all out.
+     */
+    void
+    send() {
+      ch('\n');
+      flush();
+    }
+
+  private:
+    /**
+     * Write out what we have so far.
+     */
+    void
+    flush() {
+      if (d_len) {
+        LAZY_TRACE(SEND, Trace::NO_COMMAND, d_len);
+        d_out.write(reinterpret_cast<const uint8_t *>(d_buf), d_len);
+        LAZY_TRACE(SENT, Trace::NO_COMMAND, d_len);
+        d_len = 0;
+      }
+    }
+
+    /**
+     * Make sure there's room for another n chars.
+     */
+    void
+    reserve(size_t n) {
+      if (d_len + n > sizeof(d_buf)) {
+        flush();
+      }
+    }
+
+    /**
+     * Unsigned decimal, generated two digits at a time from the back.
+     */
+    Response &
+    digits(unsigned long n) {
+      char tmp[20];  // Enough for a 64-bit unsigned long, should we be on a host.
+      uint8_t count = sizeof(tmp);
+      while (n >= 100) {
+        unsigned long q = n / 100;
+        uint8_t pair = (n - q * 100) * 2;
+        tmp[--count] = pgm_read_byte(&DIGIT_PAIRS[pair + 1]);
+        tmp[--count] = pgm_read_byte(&DIGIT_PAIRS[pair]);
+        n = q;
+      }
+      if (n >= 10) {
+        tmp[--count] = pgm_read_byte(&DIGIT_PAIRS[n * 2 + 1]);
+        tmp[--count] = pgm_read_byte(&DIGIT_PAIRS[n * 2]);
+      } else {
+        tmp[--count] = '0' + n;
+      }
+      size_t length = sizeof(tmp) - count;
+      reserve(length);
+      memcpy(d_buf + d_len, tmp + count, length);
+      d_len += length;
+      return *this;
+    }
+
+    /**
+     * The bit after the decimal point, zero-padded to 'decimals' digits.
+     */
+    Response &
+    fraction(unsigned long frac, uint8_t decimals) {
+      if ( ! decimals) {
+        return *this;
+      }
+      ch('.');
+      for (uint8_t d = decimals - 1; d > 0 && frac < power_of_ten(d); --d) {
+        ch('0');
+      }
+      return digits(frac);
+    }
+
+    Print &d_out;
+    char d_buf[LAZYSERIAL_RESPONSE_SIZE];
+    size_t d_len;
+  }; // class
+} // namespace
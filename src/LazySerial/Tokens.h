@@ -0,0 +1,126 @@
+/*
+ * This file is part of the LazySerial library.
+ * Copyright (C) 2025 Lazy Cat Software <arduino@neko.stream>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include <stdint.h>
+
+#include "LazySerial/parsing.h"
+
+
+// How many argument tokens have their positions recorded as a command comes in.
+#ifndef LAZYSERIAL_MAX_TOKENS
+  #define LAZYSERIAL_MAX_TOKENS 8
+#endif
+
+
+namespace LazySerial
+{
+  /**
+   * One more character of a command name's case-insensitive hash.
+   */
+  constexpr inline
+  uint16_t
+  name_hash_step(uint16_t hash, char ch) {
+    return static_cast<uint16_t>(hash * 31 + fold_case(ch));
+  }
+
+  /**
+   * Case-insensitive hash of a command name. constexpr, so LAZY_COMMAND() can work out its own at compile time.
+   */
+  constexpr inline
+  uint16_t
+  name_hash(const char *name, uint16_t hash = 0) {
+    return *name ? name_hash(name + 1, name_hash_step(hash, *name)) : hash;
+  }
+
+
+  /**
+   * What we know about the shape of a command line, worked out a byte at a time as it arrives, so that there is
+   * nothing left to scan for once the newline lands: where the command name ends, its hash, and where each of
+   * the first LAZYSERIAL_MAX_TOKENS whitespace-separated argument tokens start.
+   */
+  struct Tokens {
+    uint16_t name_end;   // Offset of the ' ' or '\0' after the command name.
+    uint16_t name_hash;
+    uint8_t  count;      // How many argument tokens were recorded.
+    uint16_t starts[LAZYSERIAL_MAX_TOKENS];  // Offset of each, relative to the start of the args.
+    bool     in_name;
+    bool     in_token;
+
+    void
+    reset() {
+      name_end = 0;
+      name_hash = 0;
+      count = 0;
+      in_name = true;
+      in_token = false;
+    }
+
+    /**
+     * Take note of the character that has just been stored at 'offset' in the line.
+     */
+    void
+    feed(char ch, uint16_t offset) {
+      if (in_name) {
+        if (ch == ' ') {
+          in_name = false;
+          name_end = offset;
+        } else {
+          name_hash = name_hash_step(name_hash, ch);
+        }
+        return;
+      }
+      if (is_space(ch)) {
+        in_token = false;
+      } else if ( ! in_token) {
+        in_token = true;
+        if (count < LAZYSERIAL_MAX_TOKENS) {
+          starts[count++] = offset - name_end - 1;
+        }
+      }
+    }
+
+    /**
+     * The line ended at 'length'.
+     */
+    void
+    finish(uint16_t length) {
+      if (in_name) {
+        name_end = length;
+      }
+    }
+
+    /**
+     * Work it all out in one go, for a line that didn't arrive a byte at a time.
+     */
+    void
+    scan(const char *line) {
+      reset();
+      uint16_t offset = 0;
+      for (; line[offset]; ++offset) {
+        feed(line[offset], offset);
+      }
+      finish(offset);
+    }
+
+    /**
+     * As above, for a command name and its args that have already been split apart.
+     */
+    void
+    scan(const char *name, const char *args) {
+      reset();
+      uint16_t offset = 0;
+      for (; name[offset]; ++offset) {
+        feed(name[offset], offset);
+      }
+      feed(' ', offset++);
+      for (const char *ch = args; *ch; ++ch) {
+        feed(*ch, offset++);
+      }
+      finish(offset);
+    }
+  }; // struct
+} // namespace
@@ -0,0 +1,110 @@
+/*
+ * This file is part of the LazySerial library.
+ * Copyright (C) 2025 Lazy Cat Software <arduino@neko.stream>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include <Arduino.h>
+
+
+// Define LAZYSERIAL_TRACE before including LazySerial.h to record what LazySerial gets up to in a ring
+// buffer, for the built-in TRACE command to dump. Without it, tracing compiles away to nothing.
+#ifndef LAZYSERIAL_TRACE_SIZE
+  #define LAZYSERIAL_TRACE_SIZE 32  // At most 255.
+#endif
+
+#ifdef LAZYSERIAL_TRACE
+  #define LAZY_TRACE(TYPE, COMMAND, BYTES) ::LazySerial::Trace::record(::LazySerial::Trace::TYPE, COMMAND, BYTES)
+#else
+  #define LAZY_TRACE(TYPE, COMMAND, BYTES) do { } while (0)
+#endif
+
+
+namespace LazySerial
+{
+  namespace Trace {
+    /**
+     * What happened. The TRACE command names these in this order, so keep TYPE_NAMES in step.
+     */
+    enum Type : uint8_t {
+      RECEIVE,   // A complete line arrived; bytes is its length.
+      OVERRUN,   // A line was too long for the buffer, and thrown away.
+      DISPATCH,  // Started looking for a command to run; bytes is the length of its args.
+      FINISH,    // The command at that index finished.
+      USAGE,     // The command at that index had trouble with its args.
+      HELP,      // Nothing matched, so help was run.
+      SEND,      // About to write bytes of response...
+      SENT,      // ...which took until now.
+    };
+    #define LAZYSERIAL_TRACE_TYPE_NAMES "RECEIVE|OVERRUN|DISPATCH|FINISH|USAGE|HELP|SEND|SENT"
+
+    static const uint8_t NO_COMMAND = 0xFF;
+
+    /**
+     * 8 bytes per event.
+     */
+    struct Event {
+      uint32_t micros;
+      uint8_t  type;
+      uint8_t  command;  // Index into the command list, or NO_COMMAND.
+      uint16_t bytes;
+    };
+
+    struct Buffer {
+      Event   events[LAZYSERIAL_TRACE_SIZE];
+      uint8_t next;     // Where the next event goes.
+      uint8_t count;    // How many are valid, up to LAZYSERIAL_TRACE_SIZE.
+      bool    paused;   // So that dumping the trace doesn't fill it up again.
+    };
+
+    /**
+     * The one and only trace buffer, shared by everything that includes this.
+     */
+    inline
+    Buffer &
+    buffer() {
+      static Buffer trace_buffer;
+      return trace_buffer;
+    }
+
+    /**
+     * Use the LAZY_TRACE() macro rather than calling this, so that it goes away when tracing is off.
+     * With an Executor running on another core, the odd event may get trampled.
+     */
+    inline
+    void
+    record(Type type, uint8_t command, uint16_t bytes) {
+      Buffer &trace = buffer();
+      if (trace.paused) {
+        return;
+      }
+      Event &event = trace.events[trace.next];
+      event.micros = micros();
+      event.type = type;
+      event.command = command;
+      event.bytes = bytes;
+      trace.next = (trace.next + 1) % LAZYSERIAL_TRACE_SIZE;
+      if (trace.count < LAZYSERIAL_TRACE_SIZE) {
+        trace.count++;
+      }
+    }
+
+    /**
+     * The i'th oldest event still in the buffer.
+     */
+    inline
+    const Event &
+    event(uint8_t i) {
+      Buffer &trace = buffer();
+      return trace.events[(trace.next + LAZYSERIAL_TRACE_SIZE - trace.count + i) % LAZYSERIAL_TRACE_SIZE];
+    }
+
+    inline
+    void
+    clear() {
+      buffer().next = 0;
+      buffer().count = 0;
+    }
+  } // namespace
+} // namespace
@@ -0,0 +1,201 @@
+/*
+ * This file is part of the LazySerial library.
+ * Copyright (C) 2025 Lazy Cat Software <arduino@neko.stream>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include <Arduino.h>
+
+#include "LazySerial/helpers.h"
+#include "LazySerial/Response.h"
+
+
+// How often a watch gets sampled, at most; one with a longer min_interval_ms is sampled at that instead.
+// Every watch costs a sample per period whether it has changed or not, e.g. ~110us of analogRead() on AVR.
+#ifndef LAZYSERIAL_WATCH_POLL_MS
+  #define LAZYSERIAL_WATCH_POLL_MS 20
+#endif
+
+
+namespace LazySerial
+{
+  /**
+   * Function pointer signature for sampling a watched source, e.g. reading the pin numbered 'source'.
+   */
+  typedef int32_t (*SampleFunction)(uint8_t source);
+
+  static const int32_t NO_THRESHOLD = INT32_MIN;
+
+
+  /**
+   * One subscription in a WatchPool.
+   */
+  struct Watch {
+    SampleFunction sample;     // nullptr if this slot is free.
+    uint8_t  source;
+    int32_t  deadband;         // Report when the value moves by more than this from the last one reported...
+    int32_t  threshold;        // ...or crosses this, unless it's NO_THRESHOLD...
+    uint16_t heartbeat_ms;     // ...or this long has passed without a report, unless it's 0.
+    uint16_t min_interval_ms;  // But never sample, so never report, more often than this.
+    bool     reported;         // Whether last_value is valid yet.
+    int32_t  last_value;
+    uint32_t last_ms;          // When we last reported.
+    uint32_t due_ms;           // When it's next worth sampling.
+  };
+
+
+  /**
+   * A fixed pool of up to N subscriptions, which only say something when there is something to say:
+   * each is sampled, and compared against the last value reported. Reports are "EVENT <source> <value>" lines.
+   * Call loop() from your own loop(); it keeps track of the earliest time any watch is due, and does
+   * nothing at all until then.
+   */
+  template <size_t N>
+  class WatchPool {
+  public:
+    explicit
+    WatchPool(
+        Print &out) :
+      d_out(out),
+      d_due_ms(0) {
+      clear();
+    }
+
+    /**
+     * Watch 'source', sampling it with 'sample', replacing any existing watch on the same source.
+     * The first sample is always reported. Returns false if the pool is full.
+     */
+    bool
+    add(
+        uint8_t source,
+        SampleFunction sample,
+        int32_t deadband = 0,
+        uint16_t min_interval_ms = 0,
+        uint16_t heartbeat_ms = 0,
+        int32_t threshold = NO_THRESHOLD) {
+      Watch *watch = find(source);
+      if ( ! watch) {
+        watch = find_free();
+      }
+      LAZY_RETURN_FALSE_UNLESS(watch);
+
+      watch->sample = sample;
+      watch->source = source;
+      watch->deadband = deadband;
+      watch->threshold = threshold;
+      watch->heartbeat_ms = heartbeat_ms;
+      watch->min_interval_ms = min_interval_ms;
+      watch->reported = false;
+      watch->due_ms = millis();
+      d_due_ms = watch->due_ms;
+      return true;
+    }
+
+    /**
+     * Stop watching 'source'. Returns false if we weren't.
+     */
+    bool
+    remove(
+        uint8_t source) {
+      Watch *watch = find(source);
+      LAZY_RETURN_FALSE_UNLESS(watch);
+      watch->sample = nullptr;
+      return true;
+    }
+
+    void
+    clear() {
+      for (size_t i = 0; i < N; ++i) {
+        d_watches[i].sample = nullptr;
+      }
+    }
+
+    /**
+     * The watch on 'source', or nullptr.
+     */
+    Watch *
+    find(
+        uint8_t source) {
+      for (size_t i = 0; i < N; ++i) {
+        if (d_watches[i].sample && d_watches[i].source == source) {
+          return &d_watches[i];
+        }
+      }
+      return nullptr;
+    }
+
+    size_t
+    count() const {
+      size_t active = 0;
+      for (size_t i = 0; i < N; ++i) {
+        if (d_watches[i].sample) {
+          active++;
+        }
+      }
+      return active;
+    }
+
+    void
+    loop() {
+      uint32_t now = millis();
+      LAZY_RETURN_IF(static_cast<int32_t>(now - d_due_ms) < 0);
+
+      // Nothing's due for a while if nothing's watched.
+      uint32_t next_due = now + 0xFFFF;
+      for (size_t i = 0; i < N; ++i) {
+        Watch &watch = d_watches[i];
+        if ( ! watch.sample) {
+          continue;
+        }
+        if (static_cast<int32_t>(now - watch.due_ms) >= 0) {
+          check(watch, now);
+        }
+        if (static_cast<int32_t>(watch.due_ms - next_due) < 0) {
+          next_due = watch.due_ms;
+        }
+      }
+      d_due_ms = next_due;
+    }
+
+  private:
+    Watch *
+    find_free() {
+      for (size_t i = 0; i < N; ++i) {
+        if ( ! d_watches[i].sample) {
+          return &d_watches[i];
+        }
+      }
+      return nullptr;
+    }
+
+    /**
+     * Sample a watch that is due, report it if need be, and work out when it's next due.
+     */
+    void
+    check(
+        Watch &watch,
+        uint32_t now) {
+      int32_t value = watch.sample(watch.source);
+      bool report = ! watch.reported;
+      if ( ! report) {
+        int32_t change = value - watch.last_value;
+        report = (change > watch.deadband || -change > watch.deadband)
+              || (watch.threshold != NO_THRESHOLD && (value >= watch.threshold) != (watch.last_value >= watch.threshold))
+              || (watch.heartbeat_ms && now - watch.last_ms >= watch.heartbeat_ms);
+      }
+      // Whether it's anything to report or not, there's no point looking again before we could report it.
+      watch.due_ms = now + (watch.min_interval_ms > LAZYSERIAL_WATCH_POLL_MS ? watch.min_interval_ms : LAZYSERIAL_WATCH_POLL_MS);
+      LAZY_RETURN_UNLESS(report);
+
+      Response(d_out).str(F("EVENT ")).num(watch.source).ch(' ').num(value).send();
+      watch.reported = true;
+      watch.last_value = value;
+      watch.last_ms = now;
+    }
+
+    Print &d_out;
+    Watch d_watches[N];
+    uint32_t d_due_ms;  // The earliest any watch is due.
+  }; // class
+} // namespace
@@ -5,6 +5,18 @@
  * SPDX-License-Identifier: MIT
  */
 #pragma once
+#include <limits.h>  // ULONG_MAX
+#include <stdint.h>
+#include <string.h>  // memcpy
+
+// Decode hex 4 chars at a time in a 32-bit word, where that is cheaper than byte by byte (it isn't on AVR).
+#ifndef LAZYSERIAL_SWAR
+  #if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__ && ! defined(__AVR__)
+    #define LAZYSERIAL_SWAR 1
+  #else
+    #define LAZYSERIAL_SWAR 0
+  #endif
+#endif
 
 /**
  * Helper for parsing. Hex or Dec is fine.
@@ -25,6 +37,16 @@ is_space(char ch) {
 }
 
 
+/**
+ * Lowercase ASCII letters, leave anything else be.
+ */
+constexpr inline
+char
+fold_case(char ch) {
+  return (ch >= 'A' && ch <= 'Z') ? ch | 0x20 : ch;
+}
+
+
 /**
  * Check for '0x'
  */
@@ -35,3 +57,88 @@ is_hex_sigil(char *pos) {
 }
 
 
+
+
+/**
+ * Whether a number, parsed as a sign and a magnitude, fits in integer type T as it is: "300" doesn't fit in a
+ * uint8_t, and nor does "-1".
+ */
+template <typename T>
+inline
+bool
+fits_int(bool negative, unsigned long magnitude) {
+  static_assert(sizeof(T) <= sizeof(unsigned long), "fits_int() works in unsigned long");
+  const bool is_signed = static_cast<T>(0) > static_cast<T>(-1);
+  const unsigned long max = is_signed ? (1UL << (8 * sizeof(T) - 1)) - 1 : static_cast<T>(~static_cast<T>(0));
+  if (negative) {
+    // A signed type goes one further below zero than above.
+    return is_signed ? magnitude <= max + 1 : magnitude == 0;
+  }
+  return magnitude <= max;
+}
+
+
+/**
+ * Value of a single hex digit, or 0xFF if it isn't one.
+ */
+inline
+uint8_t
+hex_nibble(char ch) {
+  if (ch >= '0' && ch <= '9') {
+    return ch - '0';
+  }
+  ch |= 0x20;  // lowercase
+  if (ch >= 'a' && ch <= 'f') {
+    return ch - 'a' + 10;
+  }
+  return 0xFF;
+}
+
+
+/**
+ * For each of the 4 bytes in x, 0x80 if lo < byte < hi, else 0. Only valid for bytes < 0x80.
+ * Ref: "Determine if a word has a byte between m and n", https://graphics.stanford.edu/~seander/bithacks.html
+ */
+inline
+uint32_t
+swar_between(uint32_t x, uint8_t lo, uint8_t hi) {
+  return (0x01010101u * (127 + hi) - x) & ~x & (x + 0x01010101u * (127 - lo)) & 0x80808080u;
+}
+
+
+/**
+ * Decode 2*n hex digits from src into n bytes at dst. Returns false if it hits something that isn't hex.
+ * dst may be the same as src, for decoding in place: each byte is written after the digits it came from are read.
+ */
+inline
+bool
+decode_hex(const char *src, uint8_t *dst, size_t n) {
+#if LAZYSERIAL_SWAR
+  for (; n >= 2; n -= 2, src += 4, dst += 2) {
+    uint32_t w;
+    memcpy(&w, src, sizeof(w));
+    if (w & 0x80808080u) {
+      return false;
+    }
+    uint32_t is_hex = swar_between(w, '0' - 1, '9' + 1) | swar_between(w | 0x20202020u, 'a' - 1, 'f' + 1);
+    if (is_hex != 0x80808080u) {
+      return false;
+    }
+    // Low nibble of each char is the value for '0'-'9'; letters have bit 6 set, and need 9 more.
+    uint32_t nibbles = (w & 0x0F0F0F0Fu) + ((w >> 6) & 0x01010101u) * 9;
+    // Little-endian, so the first char is the low byte. Pair them up into bytes 0 and 2.
+    uint32_t pairs = ((nibbles << 4) | (nibbles >> 8)) & 0x00FF00FFu;
+    dst[0] = pairs;
+    dst[1] = pairs >> 16;
+  }
+#endif
+  for (; n > 0; n--, src += 2, dst++) {
+    uint8_t hi = hex_nibble(src[0]);
+    uint8_t lo = hex_nibble(src[1]);
+    if ((hi | lo) & 0xF0) {
+      return false;
+    }
+    *dst = (hi << 4) | lo;
+  }
+  return true;
+}